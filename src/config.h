@@ -5,7 +5,7 @@
 // BLE Configuration
 // =============================================================================
 
-// Device name shown in BLE scan
+// Device name shown in BLE scan (followed by the last three MAC bytes)
 #define BLE_DEVICE_NAME "AutoPrintFarm Hub"
 
 // WiFi Provisioning Service UUID
@@ -28,6 +28,136 @@
 #define MAX_SSID_LENGTH     32
 #define MAX_PASSWORD_LENGTH 64
 
+// =============================================================================
+// Link Monitor Configuration
+// =============================================================================
+
+// Sampling intervals
+#define LINK_RSSI_INTERVAL_MS  1000
+#define LINK_RTT_INTERVAL_MS   2000
+#define LINK_RTT_TIMEOUT_MS    1000   // Lost pings count as this RTT
+
+// Stretched sampling in the low-power profile: each ping wakes the radio
+// between DTIM beacons and each sample keeps the CPU out of light sleep
+#define LINK_RSSI_INTERVAL_LOW_POWER_MS 10000
+#define LINK_RTT_INTERVAL_LOW_POWER_MS  30000
+
+// EWMA smoothing factor in percent (weight of the newest sample)
+#define LINK_EWMA_ALPHA_PCT    20
+
+// Link is considered poor below/above these smoothed values
+#define LINK_POOR_RSSI_DBM     -72
+#define LINK_POOR_RTT_MS       150
+
+// A candidate AP must be this much stronger than the current link to roam
+#define LINK_ROAM_HYSTERESIS_DB 8
+
+// Minimum time between roam scans, and give-up time for a roam attempt
+#define LINK_ROAM_COOLDOWN_MS  60000
+#define LINK_ROAM_TIMEOUT_MS   5000
+
+// Number of roam events kept for reporting
+#define LINK_ROAM_HISTORY      8
+
+// =============================================================================
+// Power Profile Configuration
+// =============================================================================
+
+// Power Service UUID
+#define SERVICE_UUID_POWER "4fafc203-1fb5-459e-8fcc-c5c9c331914b"
+
+#define CHAR_UUID_POWER_PROFILE "beb54844-36e1-4688-b7f5-ea07361b26a8"  // Read/Write
+#define CHAR_UUID_POWER_STATS   "beb54845-36e1-4688-b7f5-ea07361b26a8"  // Read only
+#define CHAR_UUID_POWER_ECHO    "beb54848-36e1-4688-b7f5-ea07361b26a8"  // Write/Notify
+
+// Longest time loop() sleeps without an event, per profile
+#define POWER_LOOP_PERIOD_MAX_PERF_MS  10
+#define POWER_LOOP_PERIOD_BALANCED_MS  50
+#define POWER_LOOP_PERIOD_LOW_POWER_MS 250
+
+// BLE advertising interval range per profile (max-performance keeps the
+// NimBLE default of 30-60 ms)
+#define POWER_ADV_MIN_MAX_PERF_MS  30
+#define POWER_ADV_MAX_MAX_PERF_MS  60
+#define POWER_ADV_INTERVAL_BALANCED_MS  100
+#define POWER_ADV_INTERVAL_LOW_POWER_MS 1000
+
+// Nominal average current draw (mA) with WiFi associated, from ESP32-S3
+// datasheet typicals plus PSRAM and BLE advertising overhead. Not measured:
+// the low-power figure assumes light sleep, which the BLE controller's PM
+// lock can prevent
+#define POWER_NOMINAL_MA_MAX_PERF  110
+#define POWER_NOMINAL_MA_BALANCED  45
+#define POWER_NOMINAL_MA_LOW_POWER 12
+
+// How often the wake latency is probed with a timer wake from idle
+#define POWER_WAKE_PROBE_INTERVAL_MS 5000
+
+// Longest token echoed back on the Power Echo characteristic
+#define POWER_ECHO_MAX_LENGTH 16
+
+// =============================================================================
+// Job Scheduler Configuration
+// =============================================================================
+
+// Job Service UUID
+#define SERVICE_UUID_JOBS "4fafc204-1fb5-459e-8fcc-c5c9c331914b"
+
+#define CHAR_UUID_JOB_COMMAND "beb54846-36e1-4688-b7f5-ea07361b26a8"  // Write only
+#define CHAR_UUID_JOB_EVENTS  "beb54847-36e1-4688-b7f5-ea07361b26a8"  // Read/Notify
+
+// Capacity (the NVS snapshot is 13 + 22 bytes per job)
+#define SCHED_MAX_JOBS     256
+#define SCHED_MAX_PRINTERS 64
+
+// Dispatches per job before it is given up
+#define SCHED_MAX_ATTEMPTS 3
+
+// A dispatched job is requeued if its printer does not start within this time
+#define SCHED_DISPATCH_TIMEOUT_MS 120000
+
+// Snapshot is written this long after the last change (limits flash wear)
+#define SCHED_SNAPSHOT_DELAY_MS 2000
+
+// Retry interval while the NVS partition has no room for the snapshot
+#define SCHED_SNAPSHOT_RETRY_MS 60000
+
+// BLE commands buffered between loop iterations
+#define SCHED_COMMAND_QUEUE_LENGTH 16
+
+// =============================================================================
+// Printer Discovery Configuration
+// =============================================================================
+
+// Hub mDNS hostname is this prefix plus the last three MAC bytes (apf-hub-a1b2c3.local)
+#define DISCOVERY_HOSTNAME_PREFIX "apf-hub"
+
+// DNS-SD service types browsed for printers (OctoPrint, Moonraker/Klipper)
+#define DISCOVERY_SERVICE_TYPES { "_octoprint._tcp.local", "_moonraker._tcp.local" }
+
+// Cache capacity (service instances)
+#define DISCOVERY_MAX_PRINTERS 64
+
+// Browse queries after connecting, spaced 1 s, 2 s, ... apart
+#define DISCOVERY_STARTUP_QUERIES     3
+#define DISCOVERY_STARTUP_INTERVAL_MS 1000
+
+// Minimum spacing of refresh queries (due records are batched)
+#define DISCOVERY_MIN_QUERY_INTERVAL_MS 1000
+
+// Records due for a refresh within this window join the current query,
+// so printers answering a browse at slightly different times stay in step
+#define DISCOVERY_REFRESH_BATCH_MS 2000
+
+// Retry interval if joining the multicast group fails
+#define DISCOVERY_RETRY_MS 5000
+
+// Receive buffer (larger responses are parsed up to this size)
+#define DISCOVERY_PACKET_SIZE 1500
+
+// Packets handled per loop iteration
+#define DISCOVERY_MAX_PACKETS_PER_POLL 16
+
 // =============================================================================
 // NVS Configuration
 // =============================================================================
@@ -37,6 +167,12 @@
 #define NVS_KEY_PASSWORD   "password"
 #define NVS_KEY_VALID      "valid"
 
+#define NVS_NAMESPACE_POWER "power"
+#define NVS_KEY_PROFILE     "profile"
+
+#define NVS_NAMESPACE_JOBS  "jobs"
+#define NVS_KEY_SNAPSHOT    "snapshot"
+
 // =============================================================================
 // Command Values (written to Command characteristic)
 // =============================================================================
@@ -56,4 +192,92 @@
 #define STATUS_DISCONNECTED   0x04  // Explicitly disconnected
 #define STATUS_NO_CREDENTIALS 0x05  // No SSID/password stored
 
+// =============================================================================
+// OTA Update Configuration
+// =============================================================================
+
+// OTA Service UUID (firmware delivered over GATT)
+#define SERVICE_UUID_OTA "4fafc202-1fb5-459e-8fcc-c5c9c331914b"
+
+#define CHAR_UUID_OTA_CONTROL "beb54842-36e1-4688-b7f5-ea07361b26a8"  // Read/Write/Notify
+#define CHAR_UUID_OTA_DATA    "beb54843-36e1-4688-b7f5-ea07361b26a8"  // Write without response:
+                                                                       // [u32 payload offset LE][data]
+
+// Pipeline: chunks are received into one buffer while earlier ones are flashed
+#define OTA_CHUNK_SIZE      4096
+#define OTA_PIPELINE_DEPTH  4
+
+// How long the HTTP download waits for a free buffer before giving up (GATT
+// writes never wait: they are refused with OTA_STATUS_BUSY instead)
+#define OTA_BUFFER_WAIT_MS  5000
+
+// Transfer is aborted if no data arrives for this long
+#define OTA_IDLE_TIMEOUT_MS 30000
+
+// New firmware must confirm a healthy boot within this time or it is rolled back
+#define OTA_ROLLBACK_TIMEOUT_MS 120000
+
+// Delay between successful update and reboot (lets the final notify go out)
+#define OTA_REBOOT_DELAY_MS 1000
+
+// Maximum length of an HTTP firmware URL
+#define OTA_MAX_URL_LENGTH 256
+
+// Public key used to verify firmware signatures (ECDSA P-256 over SHA-256) is
+// not kept in the source: tools/ota_signing_key.py generates OTA_SIGNING_PUBKEY_PEM
+// from the PEM file named by custom_ota_signing_pubkey in platformio.ini (the
+// default env uses a development key that accepts no image)
+
+// =============================================================================
+// Power Profile Values (read/written on Power Profile characteristic)
+// =============================================================================
+
+#define POWER_PROFILE_MAX_PERF  0x00  // Fixed 240 MHz, WiFi power save off unless BLE is up
+#define POWER_PROFILE_BALANCED  0x01  // Modem sleep, dynamic CPU frequency (default)
+#define POWER_PROFILE_LOW_POWER 0x02  // DTIM-aligned light sleep, slow advertising
+
+// =============================================================================
+// Job Command Values (written to Job Command characteristic)
+// =============================================================================
+
+#define JOB_CMD_ADD     0x01  // [cmd][u32 file id][u8 priority][u8 material][u8 nozzle]
+#define JOB_CMD_CANCEL  0x02  // [cmd][u32 job id]
+#define JOB_CMD_RESULT  0x03  // [cmd][u32 job id][u8 success]
+#define JOB_CMD_PRINTER 0x04  // [cmd][u8 status][u16 materials][u8 nozzle][name]
+
+// =============================================================================
+// Job Event Values (notified on Job Events characteristic)
+// =============================================================================
+
+#define JOB_EVENT_ADDED      0x01  // [event][u32 job id][u32 file id][u32 0]
+#define JOB_EVENT_DISPATCHED 0x02  // [event][u32 job id][u32 file id][u32 printer key]
+#define JOB_EVENT_DONE       0x03
+#define JOB_EVENT_FAILED     0x04  // Gave up after SCHED_MAX_ATTEMPTS
+#define JOB_EVENT_REJECTED   0x05  // Command could not be applied
+
+// =============================================================================
+// OTA Command Values (written to OTA Control characteristic)
+// =============================================================================
+
+#define OTA_CMD_BEGIN      0x01  // [cmd][u32 payload size LE] - start GATT transfer
+#define OTA_CMD_END        0x02  // [cmd][DER signature] - finish and verify
+#define OTA_CMD_ABORT      0x03  // Cancel the update in progress
+#define OTA_CMD_BEGIN_HTTP 0x04  // [cmd][url] - download image (and url.sig) over WiFi
+
+// =============================================================================
+// OTA Status Values (read/notified from OTA Control characteristic)
+// =============================================================================
+
+#define OTA_STATUS_IDLE      0x00  // No update in progress
+#define OTA_STATUS_RECEIVING 0x01  // Receiving and writing image
+#define OTA_STATUS_VERIFYING 0x02  // Checking signature and image
+#define OTA_STATUS_SUCCESS   0x03  // New image ready, rebooting
+#define OTA_STATUS_ERROR     0x04  // Update failed (see error code)
+#define OTA_STATUS_BUSY      0x05  // A data write was dropped (buffers full or wrong
+                                   // offset): pause until RECEIVING is notified
+
+// Notifications carry [status][error][u32 payload bytes accepted so far].
+// After BUSY the client resends from the offset in the RECEIVING that
+// follows; END sent short of the announced size is answered the same way
+
 #endif // CONFIG_H
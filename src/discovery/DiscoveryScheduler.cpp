@@ -0,0 +1,111 @@
+#include "DiscoveryScheduler.h"
+#include <vector>
+#include "../config.h"
+
+namespace {
+
+// Printers resolved this soon after a query count their latency from it
+const uint32_t RESPONSE_WINDOW_MS = 1000;
+
+}  // namespace
+
+DiscoveryScheduler::DiscoveryScheduler(ServiceCache& cache, uint8_t* buffer, size_t size)
+    : _cache(cache)
+    , _buffer(buffer)
+    , _size(size)
+    , _startupQueries(0)
+    , _nextStartupQuery(0)
+    , _lastQuery(0) {
+}
+
+void DiscoveryScheduler::start(uint32_t nowMs) {
+    _startupQueries = 0;
+    _nextStartupQuery = nowMs;
+}
+
+DiscoveryScheduler::Query DiscoveryScheduler::poll(uint32_t nowMs, SendCallback send) {
+    // Startup burst at 0, 1, 3 s; afterwards only refresh what is expiring
+    if (_startupQueries < DISCOVERY_STARTUP_QUERIES) {
+        if ((int32_t)(nowMs - _nextStartupQuery) < 0) {
+            return Query::NONE;
+        }
+        sendBrowseQuery(nowMs, send);
+        _nextStartupQuery = nowMs + (DISCOVERY_STARTUP_INTERVAL_MS << _startupQueries);
+        _startupQueries++;
+        return Query::BROWSE;
+    }
+
+    if (nowMs - _lastQuery < DISCOVERY_MIN_QUERY_INTERVAL_MS) {
+        return Query::NONE;
+    }
+    return sendRefreshQuery(nowMs, send) ? Query::REFRESH : Query::NONE;
+}
+
+uint32_t DiscoveryScheduler::latencyMs(uint32_t firstSeenMs, uint32_t nowMs) const {
+    uint32_t since = firstSeenMs;
+    if (_lastQuery != 0 && since - _lastQuery <= RESPONSE_WINDOW_MS) {
+        since = _lastQuery;
+    }
+    return nowMs - since;
+}
+
+void DiscoveryScheduler::sendBrowseQuery(uint32_t nowMs, SendCallback& send) {
+    struct KnownAnswer {
+        const MdnsName* service;
+        const MdnsName* instance;
+        uint32_t ttl;
+    };
+
+    std::vector<KnownAnswer> known;
+    _cache.collectKnownAnswers(nowMs, [&known](const MdnsName& service, const MdnsName& instance, uint32_t ttl) {
+        known.push_back({ &service, &instance, ttl });
+    });
+
+    // Known answers that do not fit follow in packets with the TC bit set
+    // on the one before (RFC 6762 section 7.2)
+    size_t next = 0;
+    bool first = true;
+    do {
+        MdnsQuery query(_buffer, _size);
+        if (first) {
+            for (uint8_t i = 0; i < _cache.getServiceTypeCount(); i++) {
+                query.addQuestion(_cache.getServiceType(i), MDNS_TYPE_PTR);
+            }
+        }
+        while (next < known.size() && query.addKnownAnswer(*known[next].service, *known[next].instance, known[next].ttl)) {
+            next++;
+        }
+        if (query.isEmpty()) {
+            break;
+        }
+        if (next < known.size()) {
+            query.setTruncated();
+        }
+        send(query.finish());
+        _lastQuery = nowMs;
+        first = false;
+    } while (next < known.size());
+}
+
+bool DiscoveryScheduler::sendRefreshQuery(uint32_t nowMs, SendCallback& send) {
+    MdnsQuery query(_buffer, _size);
+    bool sent = false;
+
+    _cache.collectQuestions(nowMs, [&](const MdnsName& name, uint16_t type) {
+        if (query.addQuestion(name, type)) {
+            return;
+        }
+        send(query.finish());
+        _lastQuery = nowMs;
+        sent = true;
+        query = MdnsQuery(_buffer, _size);
+        query.addQuestion(name, type);
+    }, DISCOVERY_REFRESH_BATCH_MS);
+
+    if (!query.isEmpty()) {
+        send(query.finish());
+        _lastQuery = nowMs;
+        sent = true;
+    }
+    return sent;
+}
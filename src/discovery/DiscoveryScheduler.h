@@ -0,0 +1,81 @@
+#ifndef DISCOVERY_SCHEDULER_H
+#define DISCOVERY_SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include "ServiceCache.h"
+
+/**
+ * DiscoveryScheduler - when the printer browser queries, and what it asks
+ *
+ * After start() a burst of DISCOVERY_STARTUP_QUERIES browse queries goes
+ * out at 0, 1, 3 s, listing the cached printers as known answers so only
+ * what changed gets answered. Afterwards only records due for a refresh in
+ * the ServiceCache are asked for, at most once per
+ * DISCOVERY_MIN_QUERY_INTERVAL_MS.
+ *
+ * Pure logic with no Arduino dependencies: queries are built in a caller's
+ * buffer and handed back for sending, so the schedule can be driven by a
+ * simulated network on the host.
+ */
+class DiscoveryScheduler {
+public:
+    enum class Query : uint8_t {
+        NONE,
+        BROWSE,     // Startup burst query (possibly several TC packets)
+        REFRESH     // Questions for expiring or unresolved records
+    };
+
+    /**
+     * Called once per packet; the packet is the first length bytes of the buffer
+     */
+    using SendCallback = std::function<void(size_t length)>;
+
+    /**
+     * @param cache Cache that supplies the questions and known answers
+     * @param buffer Packet buffer, DISCOVERY_PACKET_SIZE is enough
+     */
+    DiscoveryScheduler(ServiceCache& cache, uint8_t* buffer, size_t size);
+
+    /**
+     * Restart the startup burst (the network came up)
+     */
+    void start(uint32_t nowMs);
+
+    /**
+     * Send whatever query is due
+     * @return What was sent
+     */
+    Query poll(uint32_t nowMs, SendCallback send);
+
+    /**
+     * Startup queries sent since start()
+     */
+    uint8_t getStartupQueries() const { return _startupQueries; }
+
+    /**
+     * Time of the last query packet, 0 if none was sent
+     */
+    uint32_t getLastQueryMs() const { return _lastQuery; }
+
+    /**
+     * Time from query (or first announcement) to a printer being resolved:
+     * printers first heard shortly after a query count from that query
+     */
+    uint32_t latencyMs(uint32_t firstSeenMs, uint32_t nowMs) const;
+
+private:
+    ServiceCache& _cache;
+    uint8_t* _buffer;
+    size_t _size;
+
+    uint8_t _startupQueries;
+    uint32_t _nextStartupQuery;
+    uint32_t _lastQuery;
+
+    void sendBrowseQuery(uint32_t nowMs, SendCallback& send);
+    bool sendRefreshQuery(uint32_t nowMs, SendCallback& send);
+};
+
+#endif // DISCOVERY_SCHEDULER_H
@@ -0,0 +1,373 @@
+#include "MdnsPacket.h"
+#include <string.h>
+
+namespace {
+
+const size_t HEADER_SIZE = 12;
+const uint16_t FLAG_RESPONSE = 0x8000;
+const uint16_t FLAG_AUTHORITATIVE = 0x0400;
+const uint16_t FLAG_TRUNCATED = 0x0200;
+const uint16_t CLASS_IN = 1;
+const uint16_t CLASS_CACHE_FLUSH = 0x8000;
+const uint16_t CLASS_MASK = 0x7FFF;   // Top bit is cache-flush / unicast-response
+const uint8_t MAX_POINTERS = 16;      // Guards against compression loops
+
+uint8_t lower(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+bool equalsIgnoreCase(const uint8_t* a, const uint8_t* b, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (lower(a[i]) != lower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+// =============================================================================
+// MdnsName
+// =============================================================================
+
+bool MdnsName::fromDotted(const char* dotted) {
+    length = 0;
+    const char* label = dotted;
+
+    while (*label) {
+        const char* end = strchr(label, '.');
+        size_t labelLength = end ? (size_t)(end - label) : strlen(label);
+        if (labelLength == 0 || labelLength > 63 || length + labelLength + 2 > MAX_LENGTH) {
+            return false;
+        }
+
+        data[length++] = static_cast<uint8_t>(labelLength);
+        memcpy(data + length, label, labelLength);
+        length += labelLength;
+        label += labelLength + (end ? 1 : 0);
+    }
+
+    data[length++] = 0;
+    return true;
+}
+
+bool MdnsName::equals(const MdnsName& other) const {
+    return length == other.length && equalsIgnoreCase(data, other.data, length);
+}
+
+bool MdnsName::isChildOf(const MdnsName& parent) const {
+    if (length == 0 || data[0] == 0) {
+        return false;
+    }
+    size_t rest = data[0] + 1;
+    return length - rest == parent.length && equalsIgnoreCase(data + rest, parent.data, parent.length);
+}
+
+void MdnsName::firstLabel(char* out, size_t capacity) const {
+    if (capacity == 0) {
+        return;
+    }
+    size_t labelLength = length > 0 ? data[0] : 0;
+    if (labelLength >= capacity) {
+        labelLength = capacity - 1;
+    }
+    memcpy(out, data + 1, labelLength);
+    out[labelLength] = '\0';
+}
+
+// =============================================================================
+// MdnsReader
+// =============================================================================
+
+MdnsReader::MdnsReader(const uint8_t* packet, size_t length)
+    : _packet(packet)
+    , _length(length)
+    , _offset(HEADER_SIZE)
+    , _questions(0)
+    , _remaining(0)
+    , _valid(false)
+    , _response(false) {
+    if (length < HEADER_SIZE) {
+        return;
+    }
+
+    _response = (readU16(2) & FLAG_RESPONSE) != 0;
+    _questions = readU16(4);
+    _remaining = readU16(6) + readU16(8) + readU16(10);
+    _valid = true;
+}
+
+bool MdnsReader::nextQuestion(MdnsName& name, uint16_t& type) {
+    while (_questions > 0) {
+        _questions--;
+
+        if (!readName(_offset, name) || _offset + 4 > _length) {
+            _questions = 0;
+            _remaining = 0;
+            return false;
+        }
+
+        type = readU16(_offset);
+        uint16_t qClass = readU16(_offset + 2) & CLASS_MASK;
+        _offset += 4;
+
+        if (qClass == CLASS_IN) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MdnsReader::next(MdnsRecord& record) {
+    // Skip questions the caller did not read
+    MdnsName question;
+    uint16_t questionType;
+    while (nextQuestion(question, questionType)) {
+    }
+
+    while (_remaining > 0) {
+        _remaining--;
+
+        if (!readName(_offset, record.name) || _offset + 10 > _length) {
+            _remaining = 0;
+            return false;
+        }
+
+        uint16_t type = readU16(_offset);
+        uint16_t rrClass = readU16(_offset + 2) & CLASS_MASK;
+        uint32_t ttl = ((uint32_t)readU16(_offset + 4) << 16) | readU16(_offset + 6);
+        uint16_t rdLength = readU16(_offset + 8);
+        size_t rdata = _offset + 10;
+        if (rdata + rdLength > _length) {
+            _remaining = 0;
+            return false;
+        }
+        _offset = rdata + rdLength;
+
+        if (rrClass != CLASS_IN) {
+            continue;
+        }
+
+        record.type = type;
+        record.ttl = ttl;
+        size_t pos = rdata;
+
+        switch (type) {
+            case MDNS_TYPE_A:
+                if (rdLength != 4) {
+                    continue;
+                }
+                memcpy(&record.address, _packet + rdata, 4);
+                return true;
+
+            case MDNS_TYPE_PTR:
+                if (!readName(pos, record.target)) {
+                    continue;
+                }
+                return true;
+
+            case MDNS_TYPE_SRV:
+                // priority, weight, port, target
+                if (rdLength < 7) {
+                    continue;
+                }
+                record.port = readU16(rdata + 4);
+                pos = rdata + 6;
+                if (!readName(pos, record.target)) {
+                    continue;
+                }
+                return true;
+
+            case MDNS_TYPE_TXT: {
+                uint32_t hash = 2166136261u;
+                for (size_t i = 0; i < rdLength; i++) {
+                    hash ^= _packet[rdata + i];
+                    hash *= 16777619u;
+                }
+                record.txtHash = hash;
+                return true;
+            }
+
+            default:
+                continue;
+        }
+    }
+
+    return false;
+}
+
+bool MdnsReader::readName(size_t& offset, MdnsName& name) const {
+    size_t pos = offset;
+    bool jumped = false;
+    uint8_t pointers = 0;
+    name.length = 0;
+
+    for (;;) {
+        if (pos >= _length) {
+            return false;
+        }
+
+        uint8_t labelLength = _packet[pos];
+        if ((labelLength & 0xC0) == 0xC0) {
+            if (pos + 1 >= _length || ++pointers > MAX_POINTERS) {
+                return false;
+            }
+            if (!jumped) {
+                offset = pos + 2;
+                jumped = true;
+            }
+            pos = ((labelLength & 0x3F) << 8) | _packet[pos + 1];
+            continue;
+        }
+
+        if ((labelLength & 0xC0) != 0 || pos + 1 + labelLength > _length ||
+            name.length + 1 + labelLength > MdnsName::MAX_LENGTH) {
+            return false;
+        }
+
+        memcpy(name.data + name.length, _packet + pos, labelLength + 1);
+        name.length += labelLength + 1;
+        pos += labelLength + 1;
+
+        if (labelLength == 0) {
+            if (!jumped) {
+                offset = pos;
+            }
+            return true;
+        }
+    }
+}
+
+uint16_t MdnsReader::readU16(size_t offset) const {
+    return (_packet[offset] << 8) | _packet[offset + 1];
+}
+
+// =============================================================================
+// MdnsQuery
+// =============================================================================
+
+MdnsQuery::MdnsQuery(uint8_t* buffer, size_t capacity)
+    : _buffer(buffer)
+    , _capacity(capacity)
+    , _length(HEADER_SIZE)
+    , _questions(0)
+    , _answers(0)
+    , _truncated(false)
+    , _response(false)
+    , _nameCount(0) {
+}
+
+bool MdnsQuery::addQuestion(const MdnsName& name, uint16_t type) {
+    size_t start = _length;
+    uint8_t names = _nameCount;
+
+    if (_answers > 0 || _response || !writeName(name) || !writeU16(type) || !writeU16(CLASS_IN)) {
+        _length = start;
+        _nameCount = names;
+        return false;
+    }
+
+    _questions++;
+    return true;
+}
+
+bool MdnsQuery::addKnownAnswer(const MdnsName& name, const MdnsName& target, uint32_t ttl) {
+    size_t start = _length;
+    uint8_t names = _nameCount;
+
+    bool written = writeName(name) && writeU16(MDNS_TYPE_PTR) && writeU16(CLASS_IN) && writeU32(ttl);
+    size_t rdLengthOffset = _length;
+    written = written && writeU16(0) && writeName(target);
+    if (!written) {
+        _length = start;
+        _nameCount = names;
+        return false;
+    }
+
+    uint16_t rdLength = _length - rdLengthOffset - 2;
+    _buffer[rdLengthOffset] = rdLength >> 8;
+    _buffer[rdLengthOffset + 1] = rdLength & 0xFF;
+    _answers++;
+    return true;
+}
+
+bool MdnsQuery::addAddress(const MdnsName& name, uint32_t address, uint32_t ttl) {
+    size_t start = _length;
+    uint8_t names = _nameCount;
+
+    // Unique record - cache-flush tells listeners to drop older addresses
+    if (!writeName(name) || !writeU16(MDNS_TYPE_A) || !writeU16(CLASS_IN | CLASS_CACHE_FLUSH) ||
+        !writeU32(ttl) || !writeU16(4) || _length + 4 > _capacity) {
+        _length = start;
+        _nameCount = names;
+        return false;
+    }
+
+    memcpy(_buffer + _length, &address, 4);
+    _length += 4;
+    _answers++;
+    return true;
+}
+
+size_t MdnsQuery::finish() {
+    memset(_buffer, 0, HEADER_SIZE);
+    uint16_t flags = _truncated ? FLAG_TRUNCATED : 0;
+    if (_response) {
+        flags |= FLAG_RESPONSE | FLAG_AUTHORITATIVE;
+    }
+    _buffer[2] = flags >> 8;
+    _buffer[3] = flags & 0xFF;
+    _buffer[4] = _questions >> 8;
+    _buffer[5] = _questions & 0xFF;
+    _buffer[6] = _answers >> 8;
+    _buffer[7] = _answers & 0xFF;
+    return _length;
+}
+
+bool MdnsQuery::writeName(const MdnsName& name) {
+    // Write labels until the remainder matches a name already in the packet
+    size_t pos = 0;
+    while (pos < name.length && name.data[pos] != 0) {
+        for (uint8_t i = 0; i < _nameCount; i++) {
+            const MdnsName* written = _names[i];
+            if (name.length - pos == written->length &&
+                equalsIgnoreCase(name.data + pos, written->data, written->length)) {
+                return writeU16(0xC000 | _nameOffsets[i]);
+            }
+        }
+
+        uint8_t labelLength = name.data[pos];
+        if (_length + labelLength + 1 > _capacity) {
+            return false;
+        }
+        if (pos == 0 && _nameCount < MAX_NAMES && _length < 0x3FFF) {
+            _names[_nameCount] = &name;
+            _nameOffsets[_nameCount] = _length;
+            _nameCount++;
+        }
+        memcpy(_buffer + _length, name.data + pos, labelLength + 1);
+        _length += labelLength + 1;
+        pos += labelLength + 1;
+    }
+
+    if (_length + 1 > _capacity) {
+        return false;
+    }
+    _buffer[_length++] = 0;
+    return true;
+}
+
+bool MdnsQuery::writeU16(uint16_t value) {
+    if (_length + 2 > _capacity) {
+        return false;
+    }
+    _buffer[_length++] = value >> 8;
+    _buffer[_length++] = value & 0xFF;
+    return true;
+}
+
+bool MdnsQuery::writeU32(uint32_t value) {
+    return writeU16(value >> 16) && writeU16(value & 0xFFFF);
+}
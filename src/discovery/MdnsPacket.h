@@ -0,0 +1,186 @@
+#ifndef MDNS_PACKET_H
+#define MDNS_PACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * DNS resource record types used by DNS-SD
+ */
+enum MdnsType : uint16_t {
+    MDNS_TYPE_A   = 1,
+    MDNS_TYPE_PTR = 12,
+    MDNS_TYPE_TXT = 16,
+    MDNS_TYPE_SRV = 33,
+    MDNS_TYPE_ANY = 255
+};
+
+/**
+ * DNS name in wire format (length-prefixed labels, uncompressed)
+ *
+ * Kept in wire format rather than dotted text so instance names containing
+ * dots survive the round trip into refresh queries.
+ */
+struct MdnsName {
+    static constexpr uint8_t MAX_LENGTH = 128;
+
+    uint8_t length;            // Bytes used in data, including the root label
+    uint8_t data[MAX_LENGTH];
+
+    /**
+     * Build from dotted text ("_octoprint._tcp.local"), no escaping
+     * @return false if the name is too long or has an empty label
+     */
+    bool fromDotted(const char* dotted);
+
+    /**
+     * Case-insensitive comparison (mDNS names are ASCII case-insensitive)
+     */
+    bool equals(const MdnsName& other) const;
+
+    /**
+     * True if this name is exactly one label followed by parent
+     * (an instance of the service type "parent")
+     */
+    bool isChildOf(const MdnsName& parent) const;
+
+    /**
+     * Copy the first label as text, truncated to fit
+     */
+    void firstLabel(char* out, size_t capacity) const;
+};
+
+/**
+ * A decoded resource record (only the fields for its type are set)
+ */
+struct MdnsRecord {
+    MdnsName name;
+    uint16_t type;
+    uint32_t ttl;          // Seconds (0 = goodbye)
+    MdnsName target;       // PTR target or SRV host
+    uint16_t port;         // SRV
+    uint32_t address;      // A, network byte order (IPAddress compatible)
+    uint32_t txtHash;      // TXT, FNV-1a over the rdata
+};
+
+/**
+ * MdnsReader - Iterates the questions and resource records of an mDNS packet
+ *
+ * Questions are returned by nextQuestion(); answers, authority and
+ * additional records by next(), in packet order (any questions not read
+ * yet are skipped). Records of other types or classes are skipped.
+ * Parsing stops at the first malformed record, keeping what came before.
+ */
+class MdnsReader {
+public:
+    MdnsReader(const uint8_t* packet, size_t length);
+
+    /**
+     * True if the packet is a well-formed response header
+     */
+    bool isResponse() const { return _valid && _response; }
+
+    /**
+     * True if the packet is a well-formed query header
+     */
+    bool isQuery() const { return _valid && !_response; }
+
+    /**
+     * Decode the next question (class IN only)
+     * @return false when no questions are left
+     */
+    bool nextQuestion(MdnsName& name, uint16_t& type);
+
+    /**
+     * Decode the next supported record
+     * @return false when no records are left
+     */
+    bool next(MdnsRecord& record);
+
+private:
+    const uint8_t* _packet;
+    size_t _length;
+    size_t _offset;
+    uint16_t _questions;
+    uint16_t _remaining;
+    bool _valid;
+    bool _response;
+
+    bool readName(size_t& offset, MdnsName& name) const;
+    uint16_t readU16(size_t offset) const;
+};
+
+/**
+ * MdnsQuery - Builds a multicast query with known answers
+ *
+ * Names are compressed against earlier names in the packet, so a list of
+ * known instances costs little more than their instance labels.
+ *
+ * With setResponse() the same builder produces the hub's own host address
+ * answer, so the browser socket doubles as the hostname responder.
+ */
+class MdnsQuery {
+public:
+    MdnsQuery(uint8_t* buffer, size_t capacity);
+
+    /**
+     * Add a question (all questions must come before known answers)
+     * @return false if the packet is full
+     */
+    bool addQuestion(const MdnsName& name, uint16_t type);
+
+    /**
+     * Add a known PTR answer, suppressing responses we already have
+     * @param ttl Remaining TTL in seconds
+     * @return false if the packet is full (nothing is written)
+     */
+    bool addKnownAnswer(const MdnsName& name, const MdnsName& target, uint32_t ttl);
+
+    /**
+     * Add an A record for one of our own names (cache-flush set)
+     * @param address IPv4, network byte order
+     * @return false if the packet is full (nothing is written)
+     */
+    bool addAddress(const MdnsName& name, uint32_t address, uint32_t ttl);
+
+    /**
+     * More known answers follow in the next packet
+     */
+    void setTruncated() { _truncated = true; }
+
+    /**
+     * Send as an authoritative response instead of a query
+     * (no questions may be added)
+     */
+    void setResponse() { _response = true; }
+
+    bool isEmpty() const { return _questions == 0 && _answers == 0; }
+
+    /**
+     * Write the header
+     * @return packet length
+     */
+    size_t finish();
+
+private:
+    static constexpr uint8_t MAX_NAMES = 16;
+
+    uint8_t* _buffer;
+    size_t _capacity;
+    size_t _length;
+    uint16_t _questions;
+    uint16_t _answers;
+    bool _truncated;
+    bool _response;
+
+    // Names written so far, for compression
+    const MdnsName* _names[MAX_NAMES];
+    uint16_t _nameOffsets[MAX_NAMES];
+    uint8_t _nameCount;
+
+    bool writeName(const MdnsName& name);
+    bool writeU16(uint16_t value);
+    bool writeU32(uint32_t value);
+};
+
+#endif // MDNS_PACKET_H
@@ -0,0 +1,272 @@
+#include "PrinterDiscovery.h"
+
+namespace {
+
+const uint16_t MDNS_PORT = 5353;
+const IPAddress MDNS_GROUP(224, 0, 0, 251);
+
+// Host address records (RFC 6762 section 10)
+const uint32_t HOST_TTL_S = 120;
+const uint32_t MIN_ANSWER_INTERVAL_MS = 1000;   // Per record, RFC 6762 section 6
+const uint8_t ANNOUNCEMENTS = 2;                // RFC 6762 section 8.3
+
+const char* const SERVICE_TYPES[] = DISCOVERY_SERVICE_TYPES;
+const uint8_t SERVICE_TYPE_COUNT = sizeof(SERVICE_TYPES) / sizeof(SERVICE_TYPES[0]);
+
+const char* eventName(DiscoveryEvent event) {
+    switch (event) {
+        case DiscoveryEvent::ADDED:   return "Added";
+        case DiscoveryEvent::REMOVED: return "Removed";
+        case DiscoveryEvent::CHANGED: return "Changed";
+    }
+    return "Unknown";
+}
+
+}  // namespace
+
+PrinterDiscovery::PrinterDiscovery()
+    : _cache(DISCOVERY_MAX_PRINTERS)
+    , _scheduler(_cache, _packet, sizeof(_packet))
+    , _hostname{}
+    , _hostFqdn{}
+    , _running(false)
+    , _lastStartAttempt(0)
+    , _listenerCount(0)
+    , _lastAnswer(0)
+    , _lastLatencyMs(0)
+    , _maxLatencyMs(0)
+    , _rxCount(0)
+    , _txCount(0)
+    , _rxPerMinute(0)
+    , _txPerMinute(0)
+    , _windowStart(0) {
+    _cache.setEventCallback([this](DiscoveryEvent event, const DiscoveredPrinter& printer) {
+        onCacheEvent(event, printer);
+    });
+}
+
+void PrinterDiscovery::begin(const char* hostname) {
+    strncpy(_hostname, hostname, sizeof(_hostname) - 1);
+
+    char fqdn[sizeof(_hostname) + 8];
+    snprintf(fqdn, sizeof(fqdn), "%s.local", _hostname);
+    if (!_hostFqdn.fromDotted(fqdn)) {
+        Serial.printf("[Discovery] Invalid hostname: %s\n", _hostname);
+        _hostFqdn.length = 0;
+    }
+
+    MdnsName types[ServiceCache::MAX_SERVICE_TYPES];
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < SERVICE_TYPE_COUNT && count < ServiceCache::MAX_SERVICE_TYPES; i++) {
+        if (!types[count].fromDotted(SERVICE_TYPES[i])) {
+            Serial.printf("[Discovery] Invalid service type: %s\n", SERVICE_TYPES[i]);
+            continue;
+        }
+        count++;
+    }
+    _cache.setServiceTypes(types, count);
+}
+
+void PrinterDiscovery::poll(bool networkUp) {
+    if (networkUp && !_running) {
+        start();
+    } else if (!networkUp && _running) {
+        stop();
+    }
+
+    if (!_running) {
+        return;
+    }
+
+    receive();
+
+    unsigned long now = millis();
+    _cache.expire(now);
+
+    // The hub's address is announced with the first two startup queries
+    DiscoveryScheduler::Query sent = _scheduler.poll(now, [this](size_t length) {
+        sendPacket(length, true);
+    });
+    if (sent == DiscoveryScheduler::Query::BROWSE && _scheduler.getStartupQueries() <= ANNOUNCEMENTS) {
+        sendAddress();
+    }
+
+    if (now - _windowStart >= 60000) {
+        _rxPerMinute = _rxCount;
+        _txPerMinute = _txCount;
+        _rxCount = 0;
+        _txCount = 0;
+        _windowStart = now;
+    }
+}
+
+bool PrinterDiscovery::addListener(EventCallback callback) {
+    if (_listenerCount >= MAX_LISTENERS) {
+        Serial.println("[Discovery] Cannot register listener");
+        return false;
+    }
+
+    _listeners[_listenerCount++] = callback;
+    return true;
+}
+
+const char* PrinterDiscovery::getServiceTypeName(uint8_t serviceType) {
+    return serviceType < SERVICE_TYPE_COUNT ? SERVICE_TYPES[serviceType] : "unknown";
+}
+
+// =============================================================================
+// Network
+// =============================================================================
+
+void PrinterDiscovery::start() {
+    if (_lastStartAttempt != 0 && millis() - _lastStartAttempt < DISCOVERY_RETRY_MS) {
+        return;
+    }
+    _lastStartAttempt = millis();
+
+    // The only socket on port 5353: the IDF mDNS responder binds its own
+    // pcb without SO_REUSEADDR, so running it alongside would leave one of
+    // the two deaf. The hostname is answered from this socket instead.
+    if (!_udp.beginMulticast(MDNS_GROUP, MDNS_PORT)) {
+        Serial.println("[Discovery] Failed to join mDNS group");
+        return;
+    }
+
+    // Cached printers survive a reconnect; the startup queries list them as
+    // known answers so only what changed meanwhile gets answered
+    _running = true;
+    _lastStartAttempt = 0;
+    _scheduler.start(millis());
+    _windowStart = millis();
+    _rxCount = 0;
+    _txCount = 0;
+    _lastAnswer = 0;
+    Serial.printf("[Discovery] Browsing for printers (%u cached), answering as %s.local\n",
+                  _cache.getResolvedCount(), _hostname);
+}
+
+void PrinterDiscovery::stop() {
+    _udp.stop();
+    _running = false;
+    Serial.println("[Discovery] Stopped");
+}
+
+void PrinterDiscovery::receive() {
+    MdnsRecord record;
+
+    for (uint8_t i = 0; i < DISCOVERY_MAX_PACKETS_PER_POLL; i++) {
+        int size = _udp.parsePacket();
+        if (size <= 0) {
+            return;
+        }
+        _rxCount++;
+
+        // Multicast traffic always comes from port 5353 (RFC 6762 section 6);
+        // legacy unicast resolvers are not answered
+        if (_udp.remotePort() != MDNS_PORT) {
+            continue;
+        }
+
+        int length = _udp.read(_packet, sizeof(_packet));
+        if (length <= 0) {
+            continue;
+        }
+
+        MdnsReader reader(_packet, length);
+        if (reader.isQuery()) {
+            answerQuery(reader);
+            continue;
+        }
+        if (!reader.isResponse()) {
+            continue;
+        }
+
+        unsigned long now = millis();
+        while (reader.next(record)) {
+            _cache.handleRecord(record, now);
+        }
+    }
+}
+
+void PrinterDiscovery::sendPacket(size_t length, bool query) {
+    _udp.beginMulticastPacket();
+    _udp.write(_packet, length);
+    if (!_udp.endPacket()) {
+        Serial.printf("[Discovery] Failed to send %s\n", query ? "query" : "response");
+    }
+    _txCount++;
+}
+
+// =============================================================================
+// Hostname Responder
+// =============================================================================
+
+void PrinterDiscovery::answerQuery(MdnsReader& reader) {
+    if (_hostFqdn.length == 0) {
+        return;
+    }
+
+    MdnsName name;
+    uint16_t type;
+    bool asked = false;
+    while (reader.nextQuestion(name, type)) {
+        asked = asked || ((type == MDNS_TYPE_A || type == MDNS_TYPE_ANY) && name.equals(_hostFqdn));
+    }
+    if (!asked) {
+        return;
+    }
+
+    // Known-answer suppression (RFC 6762 section 7.1)
+    uint32_t address = static_cast<uint32_t>(WiFi.localIP());
+    MdnsRecord record;
+    while (reader.next(record)) {
+        if (record.type == MDNS_TYPE_A && record.name.equals(_hostFqdn) &&
+            record.address == address && record.ttl >= HOST_TTL_S / 2) {
+            return;
+        }
+    }
+
+    if (_lastAnswer != 0 && millis() - _lastAnswer < MIN_ANSWER_INTERVAL_MS) {
+        return;
+    }
+    sendAddress();
+}
+
+void PrinterDiscovery::sendAddress() {
+    if (_hostFqdn.length == 0) {
+        return;
+    }
+
+    MdnsQuery response(_packet, sizeof(_packet));
+    response.setResponse();
+    if (!response.addAddress(_hostFqdn, static_cast<uint32_t>(WiFi.localIP()), HOST_TTL_S)) {
+        return;
+    }
+    sendPacket(response.finish(), false);
+    _lastAnswer = millis();
+}
+
+// =============================================================================
+// Events
+// =============================================================================
+
+void PrinterDiscovery::onCacheEvent(DiscoveryEvent event, const DiscoveredPrinter& printer) {
+    IPAddress address(printer.address);
+
+    if (event == DiscoveryEvent::ADDED) {
+        _lastLatencyMs = _scheduler.latencyMs(printer.firstSeenMs, millis());
+        if (_lastLatencyMs > _maxLatencyMs) {
+            _maxLatencyMs = _lastLatencyMs;
+        }
+        Serial.printf("[Discovery] Added '%s' (%s) at %s:%u in %u ms\n",
+                      printer.name, getServiceTypeName(printer.serviceType),
+                      address.toString().c_str(), printer.port, _lastLatencyMs);
+    } else {
+        Serial.printf("[Discovery] %s '%s' (%s:%u)\n", eventName(event), printer.name,
+                      address.toString().c_str(), printer.port);
+    }
+
+    for (uint8_t i = 0; i < _listenerCount; i++) {
+        _listeners[i](event, printer);
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef PRINTER_DISCOVERY_H
+#define PRINTER_DISCOVERY_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <functional>
+#include "DiscoveryScheduler.h"
+#include "ServiceCache.h"
+#include "../config.h"
+
+/**
+ * PrinterDiscovery - mDNS/DNS-SD browser for printers on the local network
+ *
+ * Listens on the mDNS multicast group and feeds every response into a
+ * ServiceCache, so printers announcing themselves (or answering someone
+ * else's query) are picked up without the hub asking. Active queries are
+ * limited to a short startup burst with known-answer suppression and to
+ * refreshing records that are about to expire.
+ *
+ * Also answers A queries for the hub's per-device hostname from the same
+ * socket, so nothing else binds port 5353. The hostname embeds the MAC, so
+ * it is announced without probing.
+ */
+class PrinterDiscovery {
+public:
+    using EventCallback = ServiceCache::EventCallback;
+
+    PrinterDiscovery();
+
+    /**
+     * Set the hub's mDNS hostname (without ".local")
+     * Must be called before poll()
+     */
+    void begin(const char* hostname);
+
+    /**
+     * Must be called in main loop - starts and stops with the network,
+     * reads packets, expires and refreshes cache entries
+     * @param networkUp Browse only while the hub is connected
+     */
+    void poll(bool networkUp);
+
+    /**
+     * Register a consumer for add/remove/change events
+     * @return false if all listener slots are taken
+     */
+    bool addListener(EventCallback callback);
+
+    /**
+     * Fully resolved printers
+     */
+    const ServiceCache& getCache() const { return _cache; }
+    uint8_t getPrinterCount() const { return _cache.getResolvedCount(); }
+
+    /**
+     * Service type of a printer as text ("_octoprint._tcp.local")
+     */
+    static const char* getServiceTypeName(uint8_t serviceType);
+
+    /**
+     * Time from query (or first announcement) to a printer being resolved
+     */
+    uint32_t getLastLatencyMs() const { return _lastLatencyMs; }
+    uint32_t getMaxLatencyMs() const { return _maxLatencyMs; }
+
+    /**
+     * mDNS packets received and sent during the last full minute
+     */
+    uint32_t getRxPacketsPerMinute() const { return _rxPerMinute; }
+    uint32_t getTxPacketsPerMinute() const { return _txPerMinute; }
+
+    bool isRunning() const { return _running; }
+
+private:
+    static constexpr uint8_t MAX_LISTENERS = 4;
+
+    ServiceCache _cache;
+    DiscoveryScheduler _scheduler;
+    WiFiUDP _udp;
+    char _hostname[32];
+    MdnsName _hostFqdn;          // "<hostname>.local" in wire format
+    bool _running;
+    unsigned long _lastStartAttempt;
+
+    EventCallback _listeners[MAX_LISTENERS];
+    uint8_t _listenerCount;
+
+    unsigned long _lastAnswer;
+
+    // Statistics
+    uint32_t _lastLatencyMs;
+    uint32_t _maxLatencyMs;
+    uint32_t _rxCount;
+    uint32_t _txCount;
+    uint32_t _rxPerMinute;
+    uint32_t _txPerMinute;
+    unsigned long _windowStart;
+
+    uint8_t _packet[DISCOVERY_PACKET_SIZE];
+
+    void start();
+    void stop();
+    void receive();
+    void sendPacket(size_t length, bool query);
+    void answerQuery(MdnsReader& reader);
+    void sendAddress();
+    void onCacheEvent(DiscoveryEvent event, const DiscoveredPrinter& printer);
+};
+
+#endif // PRINTER_DISCOVERY_H
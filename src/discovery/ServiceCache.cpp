@@ -0,0 +1,314 @@
+#include "ServiceCache.h"
+#include <string.h>
+
+namespace {
+
+const uint32_t GOODBYE_TTL_MS = 1000;     // RFC 6762 section 10.1
+const uint32_t MAX_TTL_S = 86400;         // Keeps TTLs in ms within 32 bits
+const uint8_t REFRESH_STAGES = 2;         // Queries at 80% and 90% of the TTL
+
+}  // namespace
+
+uint32_t ServiceCache::CachedRecord::remainingMs(uint32_t nowMs) const {
+    uint32_t elapsed = nowMs - receivedMs;
+    return elapsed >= ttlMs ? 0 : ttlMs - elapsed;
+}
+
+bool ServiceCache::CachedRecord::refreshDue(uint32_t nowMs, uint32_t earlyMs) const {
+    if (!isValid() || refreshStage >= REFRESH_STAGES) {
+        return false;
+    }
+    uint32_t threshold = (ttlMs / 10) * (8 + refreshStage);
+    return nowMs - receivedMs + earlyMs >= threshold;
+}
+
+ServiceCache::ServiceCache(uint8_t capacity)
+    : _typeCount(0) {
+    _entries.resize(capacity);
+    for (auto& entry : _entries) {
+        entry = Entry{};
+    }
+}
+
+bool ServiceCache::setServiceTypes(const MdnsName* types, uint8_t count) {
+    if (count > MAX_SERVICE_TYPES) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        _types[i] = types[i];
+    }
+    _typeCount = count;
+    return true;
+}
+
+// =============================================================================
+// Record Handling
+// =============================================================================
+
+void ServiceCache::handleRecord(const MdnsRecord& record, uint32_t nowMs) {
+    switch (record.type) {
+        case MDNS_TYPE_PTR: handlePtr(record, nowMs); break;
+        case MDNS_TYPE_SRV: handleSrv(record, nowMs); break;
+        case MDNS_TYPE_TXT: handleTxt(record, nowMs); break;
+        case MDNS_TYPE_A:   handleA(record, nowMs);   break;
+    }
+}
+
+void ServiceCache::handlePtr(const MdnsRecord& record, uint32_t nowMs) {
+    bool browsed = false;
+    for (uint8_t i = 0; i < _typeCount; i++) {
+        browsed = browsed || record.name.equals(_types[i]);
+    }
+    if (!browsed) {
+        return;
+    }
+
+    Entry* entry = findEntry(record.target, nowMs, record.ttl != 0);
+    if (!entry) {
+        return;
+    }
+
+    refresh(entry->ptr, record.ttl, nowMs);
+    entry->needsService = !entry->srv.isValid();
+    update(*entry, false);
+}
+
+void ServiceCache::handleSrv(const MdnsRecord& record, uint32_t nowMs) {
+    // SRV may arrive ahead of its PTR, so it can create the entry too
+    Entry* entry = findEntry(record.name, nowMs, record.ttl != 0);
+    if (!entry) {
+        return;
+    }
+
+    bool changed = entry->printer.port != record.port;
+    entry->printer.port = record.port;
+    refresh(entry->srv, record.ttl, nowMs);
+    entry->needsService = false;
+
+    if (!entry->host.equals(record.target)) {
+        changed = true;
+        entry->host = record.target;
+        entry->a = CachedRecord{};
+        entry->printer.address = 0;
+
+        // Another service on the same host may already know its address
+        for (const auto& other : _entries) {
+            if (other.used && &other != entry && other.a.isValid() && other.host.equals(record.target)) {
+                entry->a = other.a;
+                entry->printer.address = other.printer.address;
+                break;
+            }
+        }
+    }
+
+    entry->needsAddress = !entry->a.isValid();
+    update(*entry, changed);
+}
+
+void ServiceCache::handleTxt(const MdnsRecord& record, uint32_t nowMs) {
+    Entry* entry = findEntry(record.name, nowMs, false);
+    if (!entry) {
+        return;
+    }
+
+    bool changed = entry->txt.isValid() && entry->printer.txtHash != record.txtHash;
+    entry->printer.txtHash = record.txtHash;
+    refresh(entry->txt, record.ttl, nowMs);
+    update(*entry, changed);
+}
+
+void ServiceCache::handleA(const MdnsRecord& record, uint32_t nowMs) {
+    for (auto& entry : _entries) {
+        if (!entry.used || !entry.host.equals(record.name)) {
+            continue;
+        }
+
+        bool changed = entry.printer.address != record.address;
+        entry.printer.address = record.address;
+        entry.needsAddress = false;
+        refresh(entry.a, record.ttl, nowMs);
+        update(entry, changed);
+    }
+}
+
+void ServiceCache::refresh(CachedRecord& cached, uint32_t ttl, uint32_t nowMs) {
+    cached.receivedMs = nowMs;
+    if (ttl == 0) {
+        // Goodbye - keep for a second in case it is immediately corrected
+        cached.ttlMs = GOODBYE_TTL_MS;
+        cached.refreshStage = REFRESH_STAGES;
+        return;
+    }
+    cached.ttlMs = (ttl < MAX_TTL_S ? ttl : MAX_TTL_S) * 1000;
+    cached.refreshStage = 0;
+}
+
+// =============================================================================
+// Expiry and Refresh
+// =============================================================================
+
+void ServiceCache::expire(uint32_t nowMs) {
+    for (auto& entry : _entries) {
+        if (!entry.used) {
+            continue;
+        }
+
+        // Instance is gone once either its PTR or SRV has expired
+        if ((entry.ptr.isValid() && entry.ptr.remainingMs(nowMs) == 0) ||
+            (entry.srv.isValid() && entry.srv.remainingMs(nowMs) == 0)) {
+            release(entry);
+            continue;
+        }
+
+        if (entry.txt.isValid() && entry.txt.remainingMs(nowMs) == 0) {
+            entry.txt = CachedRecord{};
+        }
+        if (entry.a.isValid() && entry.a.remainingMs(nowMs) == 0) {
+            entry.a = CachedRecord{};
+            entry.printer.address = 0;
+            update(entry, false);
+        }
+    }
+}
+
+void ServiceCache::collectQuestions(uint32_t nowMs, QuestionCallback callback, uint32_t earlyMs) {
+    // Records due soon only join a query something else already needs
+    bool anyDue = false;
+    for (const auto& entry : _entries) {
+        anyDue = anyDue || (entry.used && (entry.needsService || entry.needsAddress ||
+                                           entry.ptr.refreshDue(nowMs, 0) || entry.srv.refreshDue(nowMs, 0) ||
+                                           entry.txt.refreshDue(nowMs, 0) || entry.a.refreshDue(nowMs, 0)));
+    }
+    if (!anyDue) {
+        return;
+    }
+
+    bool typeAsked[MAX_SERVICE_TYPES] = {};
+
+    auto due = [nowMs, earlyMs](CachedRecord& cached) {
+        if (!cached.refreshDue(nowMs, earlyMs)) {
+            return false;
+        }
+        cached.refreshStage++;
+        return true;
+    };
+
+    for (auto& entry : _entries) {
+        if (!entry.used) {
+            continue;
+        }
+
+        // One PTR question per service type refreshes every instance of it
+        uint8_t type = entry.printer.serviceType;
+        if (due(entry.ptr) && !typeAsked[type]) {
+            typeAsked[type] = true;
+            callback(_types[type], MDNS_TYPE_PTR);
+        }
+        if (due(entry.srv) || entry.needsService) {
+            entry.needsService = false;
+            callback(entry.instance, MDNS_TYPE_SRV);
+        }
+        if (due(entry.txt)) {
+            callback(entry.instance, MDNS_TYPE_TXT);
+        }
+        if (due(entry.a) || entry.needsAddress) {
+            entry.needsAddress = false;
+            callback(entry.host, MDNS_TYPE_A);
+        }
+    }
+}
+
+void ServiceCache::collectKnownAnswers(uint32_t nowMs, KnownAnswerCallback callback) const {
+    for (const auto& entry : _entries) {
+        if (!entry.used || !entry.ptr.isValid()) {
+            continue;
+        }
+        uint32_t remaining = entry.ptr.remainingMs(nowMs);
+        if (remaining > entry.ptr.ttlMs / 2) {
+            callback(_types[entry.printer.serviceType], entry.instance, remaining / 1000);
+        }
+    }
+}
+
+// =============================================================================
+// Entries
+// =============================================================================
+
+uint8_t ServiceCache::getResolvedCount() const {
+    uint8_t count = 0;
+    for (const auto& entry : _entries) {
+        if (entry.used && entry.resolved) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void ServiceCache::forEachResolved(std::function<void(const DiscoveredPrinter&)> callback) const {
+    for (const auto& entry : _entries) {
+        if (entry.used && entry.resolved) {
+            callback(entry.printer);
+        }
+    }
+}
+
+ServiceCache::Entry* ServiceCache::findEntry(const MdnsName& instance, uint32_t nowMs, bool create) {
+    Entry* freeEntry = nullptr;
+    for (auto& entry : _entries) {
+        if (entry.used && entry.instance.equals(instance)) {
+            return &entry;
+        }
+        if (!entry.used && !freeEntry) {
+            freeEntry = &entry;
+        }
+    }
+
+    if (!create || !freeEntry) {
+        return nullptr;
+    }
+
+    for (uint8_t i = 0; i < _typeCount; i++) {
+        if (!instance.isChildOf(_types[i])) {
+            continue;
+        }
+
+        *freeEntry = Entry{};
+        freeEntry->used = true;
+        freeEntry->instance = instance;
+        freeEntry->printer.serviceType = i;
+        freeEntry->printer.firstSeenMs = nowMs;
+        instance.firstLabel(freeEntry->printer.name, sizeof(freeEntry->printer.name));
+        return freeEntry;
+    }
+
+    return nullptr;
+}
+
+void ServiceCache::update(Entry& entry, bool changed) {
+    bool complete = entry.ptr.isValid() && entry.srv.isValid() && entry.a.isValid();
+
+    if (complete && !entry.resolved) {
+        entry.resolved = true;
+        emit(DiscoveryEvent::ADDED, entry);
+    }
+    else if (!complete && entry.resolved) {
+        entry.resolved = false;
+        emit(DiscoveryEvent::REMOVED, entry);
+    }
+    else if (complete && changed) {
+        emit(DiscoveryEvent::CHANGED, entry);
+    }
+}
+
+void ServiceCache::release(Entry& entry) {
+    if (entry.resolved) {
+        emit(DiscoveryEvent::REMOVED, entry);
+    }
+    entry = Entry{};
+}
+
+void ServiceCache::emit(DiscoveryEvent event, const Entry& entry) {
+    if (_onEvent) {
+        _onEvent(event, entry.printer);
+    }
+}
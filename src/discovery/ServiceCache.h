@@ -0,0 +1,146 @@
+#ifndef SERVICE_CACHE_H
+#define SERVICE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include "MdnsPacket.h"
+
+/**
+ * Change delivered to discovery consumers
+ */
+enum class DiscoveryEvent : uint8_t {
+    ADDED   = 0x01,  // Fully resolved (instance, port and address known)
+    REMOVED = 0x02,  // Goodbye received or records expired
+    CHANGED = 0x03   // Address, port or TXT of a resolved printer changed
+};
+
+/**
+ * A printer service found on the local network
+ */
+struct DiscoveredPrinter {
+    char name[64];           // Service instance name, e.g. "Voron 2.4"
+    uint8_t serviceType;     // Index into the browsed service types
+    uint32_t address;        // IPv4, network byte order (IPAddress compatible)
+    uint16_t port;
+    uint32_t txtHash;        // Changes whenever the TXT record changes
+    uint32_t firstSeenMs;    // First record heard for this instance
+};
+
+/**
+ * ServiceCache - TTL-respecting DNS-SD cache of printer services
+ *
+ * Fed with every record heard on the mDNS group, so unsolicited
+ * announcements and answers to other hosts' queries keep it current
+ * without querying. A record is only re-queried when it reaches 80% (then
+ * 90%) of its TTL without being refreshed, per RFC 6762 section 5.2.
+ *
+ * Pure logic with no Arduino dependencies, so packet captures can be
+ * replayed through it on the host.
+ */
+class ServiceCache {
+public:
+    static constexpr uint8_t MAX_SERVICE_TYPES = 4;
+
+    using EventCallback = std::function<void(DiscoveryEvent event, const DiscoveredPrinter& printer)>;
+    using QuestionCallback = std::function<void(const MdnsName& name, uint16_t type)>;
+    using KnownAnswerCallback = std::function<void(const MdnsName& service, const MdnsName& instance, uint32_t ttl)>;
+
+    /**
+     * @param capacity Maximum number of cached service instances
+     */
+    ServiceCache(uint8_t capacity);
+
+    /**
+     * Set the browsed service types (e.g. "_octoprint._tcp.local")
+     * @return false if there are too many
+     */
+    bool setServiceTypes(const MdnsName* types, uint8_t count);
+
+    const MdnsName& getServiceType(uint8_t index) const { return _types[index]; }
+    uint8_t getServiceTypeCount() const { return _typeCount; }
+
+    /**
+     * Called on every add, remove and change
+     */
+    void setEventCallback(EventCallback callback) { _onEvent = callback; }
+
+    /**
+     * Apply a record heard on the network
+     */
+    void handleRecord(const MdnsRecord& record, uint32_t nowMs);
+
+    /**
+     * Drop expired records (may emit REMOVED)
+     */
+    void expire(uint32_t nowMs);
+
+    /**
+     * Report questions for records that are due for a refresh, and for
+     * instances whose SRV or address is still unknown. Each is reported
+     * once per refresh stage.
+     * @param earlyMs Once anything is due, records due within this window
+     *                are reported too, so records heard at slightly
+     *                different times keep being refreshed by one query
+     */
+    void collectQuestions(uint32_t nowMs, QuestionCallback callback, uint32_t earlyMs = 0);
+
+    /**
+     * Report cached instances with more than half their PTR TTL left
+     * (known-answer suppression, RFC 6762 section 7.1)
+     */
+    void collectKnownAnswers(uint32_t nowMs, KnownAnswerCallback callback) const;
+
+    /**
+     * Number of fully resolved printers
+     */
+    uint8_t getResolvedCount() const;
+
+    /**
+     * Visit every fully resolved printer
+     */
+    void forEachResolved(std::function<void(const DiscoveredPrinter&)> callback) const;
+
+private:
+    struct CachedRecord {
+        uint32_t receivedMs;
+        uint32_t ttlMs;          // 0 = not cached
+        uint8_t refreshStage;    // Refresh queries sent for this record
+
+        bool isValid() const { return ttlMs != 0; }
+        uint32_t remainingMs(uint32_t nowMs) const;
+        bool refreshDue(uint32_t nowMs, uint32_t earlyMs) const;
+    };
+
+    struct Entry {
+        bool used;
+        bool resolved;           // ADDED has been delivered
+        bool needsService;       // SRV question pending
+        bool needsAddress;       // A question pending
+        DiscoveredPrinter printer;
+        MdnsName instance;
+        MdnsName host;
+        CachedRecord ptr;
+        CachedRecord srv;
+        CachedRecord txt;
+        CachedRecord a;
+    };
+
+    std::vector<Entry> _entries;
+    MdnsName _types[MAX_SERVICE_TYPES];
+    uint8_t _typeCount;
+    EventCallback _onEvent;
+
+    Entry* findEntry(const MdnsName& instance, uint32_t nowMs, bool create);
+    void handlePtr(const MdnsRecord& record, uint32_t nowMs);
+    void handleSrv(const MdnsRecord& record, uint32_t nowMs);
+    void handleTxt(const MdnsRecord& record, uint32_t nowMs);
+    void handleA(const MdnsRecord& record, uint32_t nowMs);
+    void refresh(CachedRecord& cached, uint32_t ttl, uint32_t nowMs);
+    void update(Entry& entry, bool changed);
+    void release(Entry& entry);
+    void emit(DiscoveryEvent event, const Entry& entry);
+};
+
+#endif // SERVICE_CACHE_H
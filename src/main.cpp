@@ -1,7 +1,13 @@
 #include <Arduino.h>
+#include <WiFi.h>
 #include "config.h"
 #include "provisioning/CredentialStore.h"
 #include "provisioning/BLEProvisioning.h"
+#include "ota/OtaUpdater.h"
+#include "network/LinkMonitor.h"
+#include "power/PowerManager.h"
+#include "scheduler/JobScheduler.h"
+#include "discovery/PrinterDiscovery.h"
 
 // =============================================================================
 // Global Objects
@@ -9,6 +15,17 @@
 
 CredentialStore credentialStore;
 BLEProvisioning bleProvisioning(credentialStore);
+OtaUpdater otaUpdater;
+LinkMonitor linkMonitor(bleProvisioning);
+PowerManager powerManager(bleProvisioning);
+JobScheduler jobScheduler;
+PrinterDiscovery printerDiscovery;
+
+// Keep a freshly updated image in pending-verify state until it proves itself
+// (overrides the weak default in the Arduino core, which confirms immediately)
+extern "C" bool verifyRollbackLater() {
+    return true;
+}
 
 // =============================================================================
 // Setup
@@ -25,15 +42,44 @@ void setup() {
     Serial.println("================================================");
     Serial.println();
 
+    // Per-device names, so several hubs can be told apart in BLE scans and on mDNS
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    char deviceName[32];
+    char hostname[32];
+    snprintf(deviceName, sizeof(deviceName), "%s %02X%02X%02X", BLE_DEVICE_NAME, mac[3], mac[4], mac[5]);
+    snprintf(hostname, sizeof(hostname), "%s-%02x%02x%02x", DISCOVERY_HOSTNAME_PREFIX, mac[3], mac[4], mac[5]);
+
     // Initialize credential store (NVS)
     Serial.println("[Main] Initializing credential store...");
     if (!credentialStore.begin()) {
         Serial.println("[Main] ERROR: Failed to initialize credential store!");
     }
 
-    // Initialize BLE provisioning
+    // Check whether this boot is a not-yet-confirmed OTA image
+    otaUpdater.begin();
+
+    // Restore print job queue from NVS
+    Serial.println("[Main] Restoring job queue...");
+    if (!jobScheduler.begin()) {
+        Serial.println("[Main] ERROR: Failed to initialize job scheduler!");
+    }
+
+    // Initialize BLE provisioning (OTA service is hosted on the same server)
     Serial.println("[Main] Starting BLE provisioning...");
-    bleProvisioning.begin(BLE_DEVICE_NAME);
+    bleProvisioning.addServiceProvider(&otaUpdater);
+    bleProvisioning.addServiceProvider(&powerManager);
+    bleProvisioning.addServiceProvider(&jobScheduler);
+    bleProvisioning.begin(deviceName);
+
+    // Printer discovery starts browsing once WiFi is connected
+    printerDiscovery.begin(hostname);
+
+    // Apply persisted power profile (WiFi power save, CPU scaling, advertising)
+    powerManager.begin();
+
+    // Roam downtime is timed from WiFi events, so register before connecting
+    linkMonitor.begin();
 
     // Auto-connect to WiFi if credentials are stored
     if (credentialStore.hasCredentials()) {
@@ -41,6 +87,8 @@ void setup() {
         bleProvisioning.autoConnect();
     } else {
         Serial.println("[Main] No WiFi credentials stored. Use BLE provisioning to configure.");
+        // Nothing to prove without a network - accept the image
+        otaUpdater.confirmBoot();
     }
 
     Serial.println();
@@ -57,22 +105,70 @@ void loop() {
     // Poll BLE provisioning (handles WiFi connection state machine)
     bleProvisioning.poll();
 
+    // Sample link quality and roam away from weak APs
+    linkMonitor.poll();
+
+    // Apply power profile changes requested over BLE, answer latency echoes
+    powerManager.poll();
+    linkMonitor.setLowPower(powerManager.getProfile() == PowerProfile::LOW_POWER);
+
+    // Dispatch queued jobs to idle printers once the hub is on the network
+    jobScheduler.poll(bleProvisioning.getState() == ProvisioningState::CONNECTED);
+
+    // Browse for printers and keep the discovery cache fresh
+    printerDiscovery.poll(bleProvisioning.getState() == ProvisioningState::CONNECTED);
+
+    // Poll OTA (status notifications, reboot after update, rollback timeout)
+    otaUpdater.poll();
+
+    // Reaching WiFi proves a freshly updated image is healthy
+    if (bleProvisioning.getState() == ProvisioningState::CONNECTED) {
+        otaUpdater.confirmBoot();
+    }
+
     // Print status periodically (every 10 seconds)
     static unsigned long lastStatusPrint = 0;
     if (millis() - lastStatusPrint > 10000) {
         lastStatusPrint = millis();
 
         if (bleProvisioning.isWiFiConnected()) {
-            Serial.printf("[Status] WiFi: Connected | SSID: %s | IP: %s | RSSI: %d dBm\n",
+            const LinkQuality& link = linkMonitor.getQuality();
+            Serial.printf("[Status] WiFi: Connected | SSID: %s | IP: %s | RSSI: %d dBm (avg %.1f) | RTT: %.0f ms\n",
                           bleProvisioning.getConnectedSSID().c_str(),
                           bleProvisioning.getIPAddress().c_str(),
-                          bleProvisioning.getRSSI());
+                          bleProvisioning.getRSSI(),
+                          link.getRssi(),
+                          link.getRttMs());
+            JobQueue& jobs = jobScheduler.getQueue();
+            Serial.printf("[Status] Jobs: %u queued, %u running | Printers: %u (%u idle) | Dispatch: %u us (max %u)\n",
+                          jobs.getQueuedCount(),
+                          jobs.getRunningCount(),
+                          jobs.getPrinterCount(),
+                          jobs.getIdlePrinterCount(),
+                          jobScheduler.getLastDispatchUs(),
+                          jobScheduler.getMaxDispatchUs());
+            Serial.printf("[Status] Discovery: %u printers | Latency: %u ms (max %u) | mDNS: %u rx, %u tx per min\n",
+                          printerDiscovery.getPrinterCount(),
+                          printerDiscovery.getLastLatencyMs(),
+                          printerDiscovery.getMaxLatencyMs(),
+                          printerDiscovery.getRxPacketsPerMinute(),
+                          printerDiscovery.getTxPacketsPerMinute());
+            Serial.printf("[Status] Roams: %u | Time without link: %u ms\n",
+                          linkMonitor.getRoamCount(),
+                          linkMonitor.getDisconnectedMs());
+            Serial.printf("[Status] Power: %s | WiFi PS: %s | Wake latency: %u us (max %u) | Query latency: %u us | Current: %u mA (nominal, unverified)\n",
+                          PowerManager::profileName(powerManager.getProfile()),
+                          PowerManager::powerSaveName(powerManager.getWiFiPowerSave()),
+                          powerManager.getWakeLatencyUs(),
+                          powerManager.getMaxWakeLatencyUs(),
+                          powerManager.getQueryLatencyUs(powerManager.getProfile()),
+                          powerManager.getNominalCurrentMa());
         } else {
             Serial.printf("[Status] WiFi: Not connected | State: %d\n",
                           static_cast<uint8_t>(bleProvisioning.getState()));
         }
     }
 
-    // Small delay to prevent watchdog issues
-    delay(10);
+    // Sleep until an event or the profile's loop period (lets the CPU idle)
+    powerManager.waitForEvent();
 }
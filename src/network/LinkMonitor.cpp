@@ -0,0 +1,301 @@
+#include "LinkMonitor.h"
+#include <lwip/ip_addr.h>
+
+namespace {
+
+const uint8_t MAX_CANDIDATES = 16;
+const uint32_t SCAN_DWELL_MS = 120;  // Per-channel active scan time
+
+}  // namespace
+
+LinkMonitor::LinkMonitor(BLEProvisioning& provisioning)
+    : _provisioning(provisioning)
+    , _quality(LINK_EWMA_ALPHA_PCT, LINK_POOR_RSSI_DBM, LINK_POOR_RTT_MS, LINK_ROAM_HYSTERESIS_DB)
+    , _linkUp(false)
+    , _linkDownSince(0)
+    , _disconnectedMs(0)
+    , _lastRssiSample(0)
+    , _lowPower(false)
+    , _rssiIntervalMs(LINK_RSSI_INTERVAL_MS)
+    , _rttIntervalMs(LINK_RTT_INTERVAL_MS)
+    , _ping(nullptr)
+    , _rttSample(0)
+    , _rttReady(false)
+    , _scanning(false)
+    , _lastRoamScan(0)
+    , _pendingRoam{}
+    , _roamInProgress(false)
+    , _roamDownAt(0)
+    , _roamUpAt(0)
+    , _history{}
+    , _roamCount(0) {
+}
+
+void LinkMonitor::begin() {
+    // The link is down from the old AP's disconnect until the new AP gives
+    // us an address; polling isRoaming() would add up to a loop period
+    WiFi.onEvent([this](WiFiEvent_t event, WiFiEventInfo_t) {
+        if (!_roamInProgress) {
+            return;
+        }
+        if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED && _roamDownAt == 0) {
+            _roamDownAt = millis();
+        } else if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP && _roamDownAt != 0) {
+            _roamUpAt = millis();
+        }
+    });
+}
+
+void LinkMonitor::poll() {
+    // A link in the middle of a roam is not usable yet
+    bool linkUp = WiFi.status() == WL_CONNECTED && !_provisioning.isRoaming();
+
+    if (_roamInProgress && !_provisioning.isRoaming()) {
+        uint8_t* bssid = WiFi.BSSID();
+        finishRoam(linkUp && bssid && memcmp(bssid, _pendingRoam.toBssid, 6) == 0);
+    }
+
+    if (linkUp != _linkUp) {
+        _linkUp = linkUp;
+        if (linkUp) {
+            onLinkUp();
+        } else {
+            onLinkDown();
+        }
+    }
+
+    if (!_linkUp) {
+        return;
+    }
+
+    // Feed samples into the smoothed metrics
+    if (millis() - _lastRssiSample >= _rssiIntervalMs) {
+        _lastRssiSample = millis();
+        _quality.addRssi(WiFi.RSSI());
+    }
+    if (_rttReady) {
+        _rttReady = false;
+        _quality.addRtt(_rttSample);
+    }
+
+    if (_scanning) {
+        handleScanResults();
+    }
+    else if (_quality.isPoor() && (_lastRoamScan == 0 || millis() - _lastRoamScan > LINK_ROAM_COOLDOWN_MS)) {
+        startScan();
+    }
+}
+
+void LinkMonitor::setLowPower(bool lowPower) {
+    if (lowPower == _lowPower) {
+        return;
+    }
+
+    _lowPower = lowPower;
+    _rssiIntervalMs = lowPower ? LINK_RSSI_INTERVAL_LOW_POWER_MS : LINK_RSSI_INTERVAL_MS;
+    _rttIntervalMs = lowPower ? LINK_RTT_INTERVAL_LOW_POWER_MS : LINK_RTT_INTERVAL_MS;
+    Serial.printf("[Link] Sampling RSSI every %u ms, gateway RTT every %u ms\n",
+                  _rssiIntervalMs, _rttIntervalMs);
+
+    // The ping interval is fixed per session
+    if (_linkUp) {
+        startPing();
+    }
+}
+
+uint32_t LinkMonitor::getDisconnectedMs() const {
+    if (_linkUp) {
+        return _disconnectedMs;
+    }
+    return _disconnectedMs + (millis() - _linkDownSince);
+}
+
+const RoamEvent& LinkMonitor::getRoamEvent(uint8_t index) const {
+    uint8_t count = getRoamHistoryCount();
+    uint32_t first = _roamCount - count;
+    return _history[(first + index) % LINK_ROAM_HISTORY];
+}
+
+uint8_t LinkMonitor::getRoamHistoryCount() const {
+    return _roamCount < LINK_ROAM_HISTORY ? _roamCount : LINK_ROAM_HISTORY;
+}
+
+// =============================================================================
+// Link Transitions
+// =============================================================================
+
+void LinkMonitor::onLinkUp() {
+    // Time before the first connection after boot is not an outage
+    if (_linkDownSince != 0) {
+        _disconnectedMs += millis() - _linkDownSince;
+    }
+
+    _quality.reset();
+    _lastRssiSample = 0;
+    startPing();
+}
+
+void LinkMonitor::onLinkDown() {
+    _linkDownSince = millis();
+    stopPing();
+
+    if (_scanning) {
+        WiFi.scanDelete();
+        _scanning = false;
+    }
+}
+
+// =============================================================================
+// Gateway RTT
+// =============================================================================
+
+void LinkMonitor::startPing() {
+    stopPing();
+
+    ip_addr_t target;
+    if (!ipaddr_aton(WiFi.gatewayIP().toString().c_str(), &target)) {
+        return;
+    }
+
+    esp_ping_config_t config = ESP_PING_DEFAULT_CONFIG();
+    config.target_addr = target;
+    config.count = ESP_PING_COUNT_INFINITE;
+    config.interval_ms = _rttIntervalMs;
+    config.timeout_ms = LINK_RTT_TIMEOUT_MS;
+
+    esp_ping_callbacks_t callbacks = {};
+    callbacks.cb_args = this;
+    callbacks.on_ping_success = onPingSuccess;
+    callbacks.on_ping_timeout = onPingTimeout;
+
+    if (esp_ping_new_session(&config, &callbacks, &_ping) != ESP_OK) {
+        Serial.println("[Link] Failed to start gateway ping");
+        _ping = nullptr;
+        return;
+    }
+    esp_ping_start(_ping);
+}
+
+void LinkMonitor::stopPing() {
+    if (_ping) {
+        esp_ping_stop(_ping);
+        esp_ping_delete_session(_ping);
+        _ping = nullptr;
+    }
+}
+
+void LinkMonitor::onPingSuccess(esp_ping_handle_t hdl, void* args) {
+    LinkMonitor* self = static_cast<LinkMonitor*>(args);
+    uint32_t elapsed = 0;
+    esp_ping_get_profile(hdl, ESP_PING_PROF_TIMEGAP, &elapsed, sizeof(elapsed));
+    self->_rttSample = elapsed;
+    self->_rttReady = true;
+}
+
+void LinkMonitor::onPingTimeout(esp_ping_handle_t hdl, void* args) {
+    // A lost echo is the worst RTT we can measure
+    LinkMonitor* self = static_cast<LinkMonitor*>(args);
+    self->_rttSample = LINK_RTT_TIMEOUT_MS;
+    self->_rttReady = true;
+}
+
+// =============================================================================
+// Roaming
+// =============================================================================
+
+void LinkMonitor::startScan() {
+    _lastRoamScan = millis();
+    Serial.printf("[Link] Poor link (RSSI %.1f dBm, RTT %.0f ms), scanning for better AP\n",
+                  _quality.getRssi(), _quality.getRttMs());
+
+    // Async scan restricted to our SSID keeps the off-channel time short
+    String ssid = WiFi.SSID();
+    if (WiFi.scanNetworks(true, false, false, SCAN_DWELL_MS, 0, ssid.c_str()) == WIFI_SCAN_FAILED) {
+        Serial.println("[Link] Scan failed to start");
+        return;
+    }
+    _scanning = true;
+}
+
+void LinkMonitor::handleScanResults() {
+    int16_t count = WiFi.scanComplete();
+    if (count == WIFI_SCAN_RUNNING) {
+        return;
+    }
+    _scanning = false;
+
+    if (count < 0) {
+        Serial.println("[Link] Scan failed");
+        return;
+    }
+
+    String ssid = WiFi.SSID();
+    ApCandidate candidates[MAX_CANDIDATES];
+    size_t found = 0;
+    for (int16_t i = 0; i < count && found < MAX_CANDIDATES; i++) {
+        if (WiFi.SSID(i) != ssid) {
+            continue;
+        }
+        memcpy(candidates[found].bssid, WiFi.BSSID(i), 6);
+        candidates[found].rssi = WiFi.RSSI(i);
+        candidates[found].channel = WiFi.channel(i);
+        found++;
+    }
+    WiFi.scanDelete();
+
+    // The association can drop between the scan and now
+    const uint8_t* bssid = WiFi.BSSID();
+    if (!bssid) {
+        Serial.println("[Link] No current BSSID, skipping roam decision");
+        return;
+    }
+    uint8_t current[6];
+    memcpy(current, bssid, sizeof(current));
+
+    int best = _quality.selectCandidate(candidates, found, current);
+    if (best < 0) {
+        Serial.printf("[Link] No better AP among %u for '%s'\n", (unsigned)found, ssid.c_str());
+        return;
+    }
+
+    _pendingRoam = {};
+    _pendingRoam.timestamp = millis();
+    memcpy(_pendingRoam.fromBssid, current, 6);
+    memcpy(_pendingRoam.toBssid, candidates[best].bssid, 6);
+    _pendingRoam.fromRssi = static_cast<int8_t>(_quality.getRssi());
+    _pendingRoam.toRssi = candidates[best].rssi;
+
+    // Armed before roamTo(): the old AP's disconnect event can arrive before it returns
+    _roamDownAt = 0;
+    _roamUpAt = 0;
+    _roamInProgress = true;
+    if (!_provisioning.roamTo(candidates[best].bssid, candidates[best].channel)) {
+        _roamInProgress = false;
+    }
+}
+
+void LinkMonitor::finishRoam(bool success) {
+    _roamInProgress = false;
+    _pendingRoam.success = success;
+
+    // A failed roam is still down when we give up; no disconnect event means
+    // the link never dropped
+    unsigned long downAt = _roamDownAt;
+    unsigned long upAt = _roamUpAt;
+    if (downAt == 0) {
+        _pendingRoam.downtimeMs = 0;
+    } else if (success && upAt != 0) {
+        _pendingRoam.downtimeMs = upAt - downAt;
+    } else {
+        _pendingRoam.downtimeMs = millis() - downAt;
+    }
+
+    _history[_roamCount % LINK_ROAM_HISTORY] = _pendingRoam;
+    _roamCount++;
+
+    const uint8_t* to = _pendingRoam.toBssid;
+    Serial.printf("[Link] Roam %s: %d dBm -> %02X:%02X:%02X:%02X:%02X:%02X (%d dBm), %u ms without link\n",
+                  success ? "complete" : "failed", _pendingRoam.fromRssi,
+                  to[0], to[1], to[2], to[3], to[4], to[5], _pendingRoam.toRssi,
+                  _pendingRoam.downtimeMs);
+}
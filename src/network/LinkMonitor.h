@@ -0,0 +1,118 @@
+#ifndef LINK_MONITOR_H
+#define LINK_MONITOR_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <ping/ping_sock.h>
+#include "LinkQuality.h"
+#include "../provisioning/BLEProvisioning.h"
+#include "../config.h"
+
+/**
+ * A completed (or failed) roam between access points
+ */
+struct RoamEvent {
+    unsigned long timestamp;   // millis() when the roam started
+    uint8_t fromBssid[6];
+    uint8_t toBssid[6];
+    int8_t fromRssi;           // Smoothed RSSI before the roam
+    int8_t toRssi;             // Scanned RSSI of the target AP
+    uint32_t downtimeMs;       // Disconnect event to IP on the new AP
+    bool success;
+};
+
+/**
+ * LinkMonitor - Background WiFi link quality monitor with proactive roaming
+ *
+ * Samples RSSI and gateway round-trip time (ICMP echo) while connected and
+ * smooths both with an EWMA. Sampling is stretched in the low-power profile. When the link turns poor it runs an async scan
+ * for the current SSID and roams to a clearly stronger BSSID, instead of
+ * waiting for the connection to drop.
+ */
+class LinkMonitor {
+public:
+    /**
+     * Constructor
+     * @param provisioning Owner of the WiFi connection (performs the roam)
+     */
+    LinkMonitor(BLEProvisioning& provisioning);
+
+    /**
+     * Register for WiFi events (roam downtime is timed from them)
+     * Must be called once from setup(), before connecting
+     */
+    void begin();
+
+    /**
+     * Must be called in main loop - samples, scans and roams
+     */
+    void poll();
+
+    /**
+     * Stretch RSSI and gateway ping sampling for the low-power profile
+     */
+    void setLowPower(bool lowPower);
+
+    /**
+     * Smoothed link metrics
+     */
+    const LinkQuality& getQuality() const { return _quality; }
+
+    /**
+     * Total time spent without a WiFi link since boot (including roams)
+     */
+    uint32_t getDisconnectedMs() const;
+
+    /**
+     * Number of roam attempts since boot
+     */
+    uint32_t getRoamCount() const { return _roamCount; }
+
+    /**
+     * Most recent roam events, oldest first
+     * @param index 0 .. getRoamHistoryCount() - 1
+     */
+    const RoamEvent& getRoamEvent(uint8_t index) const;
+    uint8_t getRoamHistoryCount() const;
+
+private:
+    BLEProvisioning& _provisioning;
+    LinkQuality _quality;
+
+    // Connection tracking
+    bool _linkUp;
+    unsigned long _linkDownSince;
+    uint32_t _disconnectedMs;
+    unsigned long _lastRssiSample;
+    bool _lowPower;
+    uint32_t _rssiIntervalMs;
+    uint32_t _rttIntervalMs;
+
+    // Gateway RTT (written from the ping task, consumed in poll)
+    esp_ping_handle_t _ping;
+    volatile uint32_t _rttSample;
+    volatile bool _rttReady;
+
+    // Roaming
+    bool _scanning;
+    unsigned long _lastRoamScan;
+    RoamEvent _pendingRoam;
+    volatile bool _roamInProgress;        // Read from the WiFi event task
+    volatile unsigned long _roamDownAt;   // Set from the WiFi event task
+    volatile unsigned long _roamUpAt;
+    RoamEvent _history[LINK_ROAM_HISTORY];
+    uint32_t _roamCount;
+
+    void onLinkUp();
+    void onLinkDown();
+    void startPing();
+    void stopPing();
+    void startScan();
+    void handleScanResults();
+    void finishRoam(bool success);
+
+    static void onPingSuccess(esp_ping_handle_t hdl, void* args);
+    static void onPingTimeout(esp_ping_handle_t hdl, void* args);
+};
+
+#endif // LINK_MONITOR_H
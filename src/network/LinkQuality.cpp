@@ -0,0 +1,61 @@
+#include "LinkQuality.h"
+#include <string.h>
+
+LinkQuality::LinkQuality(uint8_t alphaPct, int8_t poorRssi, uint32_t poorRttMs, uint8_t hysteresisDb)
+    : _alpha(alphaPct / 100.0f)
+    , _poorRssi(poorRssi)
+    , _poorRttMs(poorRttMs)
+    , _hysteresisDb(hysteresisDb) {
+    reset();
+}
+
+void LinkQuality::reset() {
+    _rssi = 0.0f;
+    _rtt = 0.0f;
+    _hasRssi = false;
+    _hasRtt = false;
+}
+
+void LinkQuality::addRssi(int8_t rssi) {
+    if (!_hasRssi) {
+        // Seed with the first sample instead of smoothing up from zero
+        _rssi = rssi;
+        _hasRssi = true;
+        return;
+    }
+    _rssi += (rssi - _rssi) * _alpha;
+}
+
+void LinkQuality::addRtt(uint32_t rttMs) {
+    if (!_hasRtt) {
+        _rtt = rttMs;
+        _hasRtt = true;
+        return;
+    }
+    _rtt += (static_cast<float>(rttMs) - _rtt) * _alpha;
+}
+
+bool LinkQuality::isPoor() const {
+    return (_hasRssi && _rssi < _poorRssi) ||
+           (_hasRtt && _rtt > _poorRttMs);
+}
+
+int LinkQuality::selectCandidate(const ApCandidate* candidates, size_t count,
+                                 const uint8_t* currentBssid) const {
+    int best = -1;
+    float threshold = _rssi + _hysteresisDb;
+
+    for (size_t i = 0; i < count; i++) {
+        if (currentBssid && memcmp(candidates[i].bssid, currentBssid, 6) == 0) {
+            continue;
+        }
+        if (candidates[i].rssi < threshold) {
+            continue;
+        }
+        if (best < 0 || candidates[i].rssi > candidates[best].rssi) {
+            best = static_cast<int>(i);
+        }
+    }
+
+    return best;
+}
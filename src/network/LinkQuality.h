@@ -0,0 +1,84 @@
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A scanned access point that could be roamed to
+ */
+struct ApCandidate {
+    uint8_t bssid[6];
+    int8_t rssi;
+    int32_t channel;
+};
+
+/**
+ * LinkQuality - EWMA-smoothed link metrics and roaming decisions
+ *
+ * Pure logic with no Arduino dependencies, so recorded RSSI/RTT traces can
+ * be replayed through it on the host.
+ */
+class LinkQuality {
+public:
+    /**
+     * @param alphaPct Weight of the newest sample in percent (1-100)
+     * @param poorRssi Smoothed RSSI (dBm) below which the link is poor
+     * @param poorRttMs Smoothed gateway RTT above which the link is poor
+     * @param hysteresisDb Margin a candidate must exceed the current RSSI by
+     */
+    LinkQuality(uint8_t alphaPct, int8_t poorRssi, uint32_t poorRttMs, uint8_t hysteresisDb);
+
+    /**
+     * Forget all samples (call after connecting to a new AP)
+     */
+    void reset();
+
+    /**
+     * Add an RSSI sample in dBm
+     */
+    void addRssi(int8_t rssi);
+
+    /**
+     * Add a gateway round-trip time sample
+     */
+    void addRtt(uint32_t rttMs);
+
+    /**
+     * Smoothed RSSI in dBm (0 before the first sample)
+     */
+    float getRssi() const { return _rssi; }
+
+    /**
+     * Smoothed gateway RTT in ms (0 before the first sample)
+     */
+    float getRttMs() const { return _rtt; }
+
+    /**
+     * Check if smoothed RSSI or RTT crossed the poor-link threshold
+     */
+    bool isPoor() const;
+
+    /**
+     * Pick the strongest candidate worth roaming to
+     * @param candidates Scan results for the current SSID
+     * @param count Number of candidates
+     * @param currentBssid BSSID of the AP we are connected to (skipped)
+     * @return index of the chosen candidate, or -1 to stay
+     */
+    int selectCandidate(const ApCandidate* candidates, size_t count,
+                        const uint8_t* currentBssid) const;
+
+private:
+    float _alpha;
+    int8_t _poorRssi;
+    uint32_t _poorRttMs;
+    uint8_t _hysteresisDb;
+
+    float _rssi;
+    float _rtt;
+    bool _hasRssi;
+    bool _hasRtt;
+};
+
+#endif // LINK_QUALITY_H
@@ -0,0 +1,186 @@
+#include "DeltaPatcher.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+const uint8_t DELTA_MAGIC[4] = { 'A', 'P', 'F', 'D' };
+
+const uint8_t OP_COPY   = 0x01;
+const uint8_t OP_INSERT = 0x02;
+
+const size_t COPY_BUFFER_SIZE = 1024;
+
+uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+}  // namespace
+
+DeltaPatcher::DeltaPatcher()
+    : _base(nullptr)
+    , _stage(Stage::HEADER)
+    , _headerDone(false)
+    , _targetSize(0)
+    , _produced(0)
+    , _insertRemaining(0)
+    , _fieldLength(0)
+    , _error{} {
+}
+
+bool DeltaPatcher::isDelta(const uint8_t* data, size_t length) {
+    return length >= sizeof(DELTA_MAGIC) && memcmp(data, DELTA_MAGIC, sizeof(DELTA_MAGIC)) == 0;
+}
+
+void DeltaPatcher::begin(BaseImage* base, Sink sink) {
+    _base = base;
+    _sink = sink;
+    _stage = Stage::HEADER;
+    _headerDone = false;
+    _targetSize = 0;
+    _produced = 0;
+    _insertRemaining = 0;
+    _fieldLength = 0;
+    _error[0] = '\0';
+}
+
+bool DeltaPatcher::feed(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        switch (_stage) {
+            case Stage::HEADER:
+                if (!collect(data, length, HEADER_SIZE)) {
+                    return true;
+                }
+                if (!isDelta(_field, HEADER_SIZE)) {
+                    return fail("Bad magic");
+                }
+                _targetSize = readU32(_field + 4);
+                if (_targetSize == 0 || _targetSize > _base->size()) {
+                    snprintf(_error, sizeof(_error), "Bad target size: %u", (unsigned)_targetSize);
+                    return false;
+                }
+                if (!checkBaseHash(_field + 8)) {
+                    return false;
+                }
+                _headerDone = true;
+                _stage = Stage::OPCODE;
+                break;
+
+            case Stage::OPCODE: {
+                uint8_t op = *data++;
+                length--;
+                if (op == OP_COPY) {
+                    _stage = Stage::COPY_ARGS;
+                } else if (op == OP_INSERT) {
+                    _stage = Stage::INSERT_ARGS;
+                } else {
+                    snprintf(_error, sizeof(_error), "Unknown opcode: 0x%02X", op);
+                    return false;
+                }
+                break;
+            }
+
+            case Stage::COPY_ARGS:
+                if (!collect(data, length, 8)) {
+                    return true;
+                }
+                if (!copyFromBase(readU32(_field), readU32(_field + 4))) {
+                    return false;
+                }
+                _stage = Stage::OPCODE;
+                break;
+
+            case Stage::INSERT_ARGS:
+                if (!collect(data, length, 4)) {
+                    return true;
+                }
+                _insertRemaining = readU32(_field);
+                _stage = _insertRemaining > 0 ? Stage::INSERT_DATA : Stage::OPCODE;
+                break;
+
+            case Stage::INSERT_DATA: {
+                size_t n = length < _insertRemaining ? length : _insertRemaining;
+                if (!emit(data, n)) {
+                    return false;
+                }
+                data += n;
+                length -= n;
+                _insertRemaining -= n;
+                if (_insertRemaining == 0) {
+                    _stage = Stage::OPCODE;
+                }
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool DeltaPatcher::collect(const uint8_t*& data, size_t& length, size_t want) {
+    size_t n = want - _fieldLength;
+    if (n > length) {
+        n = length;
+    }
+
+    memcpy(_field + _fieldLength, data, n);
+    _fieldLength += n;
+    data += n;
+    length -= n;
+
+    if (_fieldLength < want) {
+        return false;
+    }
+
+    _fieldLength = 0;
+    return true;
+}
+
+bool DeltaPatcher::checkBaseHash(const uint8_t* expected) {
+    uint8_t actual[32];
+    if (!_base->sha256(actual)) {
+        return fail("Could not hash base image");
+    }
+
+    if (memcmp(actual, expected, sizeof(actual)) != 0) {
+        return fail("Patch was built against a different base image");
+    }
+
+    return true;
+}
+
+bool DeltaPatcher::copyFromBase(uint32_t offset, uint32_t length) {
+    if (offset > _base->size() || length > _base->size() - offset) {
+        snprintf(_error, sizeof(_error), "COPY out of range: %u+%u", (unsigned)offset, (unsigned)length);
+        return false;
+    }
+
+    uint8_t buffer[COPY_BUFFER_SIZE];
+    while (length > 0) {
+        size_t n = length < COPY_BUFFER_SIZE ? length : COPY_BUFFER_SIZE;
+        if (!_base->read(offset, buffer, n)) {
+            return fail("Base read failed");
+        }
+        if (!emit(buffer, n)) {
+            return false;
+        }
+        offset += n;
+        length -= n;
+    }
+
+    return true;
+}
+
+bool DeltaPatcher::emit(const uint8_t* data, size_t length) {
+    if (length > _targetSize - _produced) {
+        return fail("Patch produces more than target size");
+    }
+
+    _produced += length;
+    return _sink(data, length);
+}
+
+bool DeltaPatcher::fail(const char* message) {
+    snprintf(_error, sizeof(_error), "%s", message);
+    return false;
+}
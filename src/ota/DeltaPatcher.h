@@ -0,0 +1,118 @@
+#ifndef DELTA_PATCHER_H
+#define DELTA_PATCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+/**
+ * DeltaPatcher - Streaming decoder for binary delta patches
+ *
+ * Patch layout (all integers little-endian):
+ *
+ *   header:  "APFD" | u32 target size | u8[32] SHA-256 of the base image
+ *   ops:     0x01 COPY   | u32 base offset | u32 length
+ *            0x02 INSERT | u32 length | length bytes of literal data
+ *
+ * COPY reads from the base image (the running app partition on the hub),
+ * INSERT passes literal bytes through. Output is produced in order and handed to the sink, so the
+ * patch never needs to be buffered in full. The patch is complete once
+ * exactly target-size bytes have been produced.
+ *
+ * Patches are generated by tools/make_ota_delta.py.
+ */
+class DeltaPatcher {
+public:
+    using Sink = std::function<bool(const uint8_t* data, size_t length)>;
+
+    /**
+     * Image the patch was built against
+     */
+    class BaseImage {
+    public:
+        virtual ~BaseImage() = default;
+
+        /** Image size in bytes */
+        virtual uint32_t size() const = 0;
+
+        /** Read length bytes at offset */
+        virtual bool read(uint32_t offset, uint8_t* out, size_t length) = 0;
+
+        /** SHA-256 of the image as make_ota_delta.py hashes it */
+        virtual bool sha256(uint8_t* out) = 0;
+    };
+
+    static constexpr size_t HEADER_SIZE = 40;
+
+    DeltaPatcher();
+
+    /**
+     * Check if a payload starts with the delta magic
+     */
+    static bool isDelta(const uint8_t* data, size_t length);
+
+    /**
+     * Reset decoder for a new patch
+     * @param base Image that COPY ops read from
+     * @param sink Receives reconstructed image bytes
+     */
+    void begin(BaseImage* base, Sink sink);
+
+    /**
+     * Feed patch bytes (any split is allowed)
+     * @return false on malformed patch, base mismatch or sink failure
+     */
+    bool feed(const uint8_t* data, size_t length);
+
+    /**
+     * Target image size from the header (0 until header is parsed)
+     */
+    uint32_t getTargetSize() const { return _targetSize; }
+
+    /**
+     * Bytes of reconstructed image produced so far
+     */
+    uint32_t getProduced() const { return _produced; }
+
+    /**
+     * Check if the full target image has been produced
+     */
+    bool isComplete() const { return _headerDone && _produced == _targetSize; }
+
+    /**
+     * Why the last feed() failed (empty after a sink failure)
+     */
+    const char* getError() const { return _error; }
+
+private:
+    enum class Stage : uint8_t {
+        HEADER,
+        OPCODE,
+        COPY_ARGS,
+        INSERT_ARGS,
+        INSERT_DATA
+    };
+
+    BaseImage* _base;
+    Sink _sink;
+
+    Stage _stage;
+    bool _headerDone;
+    uint32_t _targetSize;
+    uint32_t _produced;
+    uint32_t _insertRemaining;
+
+    // Scratch for fields split across feed() calls
+    uint8_t _field[HEADER_SIZE];
+    size_t _fieldLength;
+
+    char _error[48];
+
+    bool fail(const char* message);
+    bool collect(const uint8_t*& data, size_t& length, size_t want);
+    bool checkBaseHash(const uint8_t* expected);
+    bool copyFromBase(uint32_t offset, uint32_t length);
+    bool emit(const uint8_t* data, size_t length);
+};
+
+#endif // DELTA_PATCHER_H
@@ -0,0 +1,802 @@
+#include "OtaUpdater.h"
+#include "../config.h"
+#include "../power/PowerManager.h"
+#include <HTTPClient.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/pk.h>
+#include <ota_signing_key.h>   // Generated at build time by tools/ota_signing_key.py
+
+#ifndef OTA_WITH_SEQUENTIAL_WRITES
+#define OTA_WITH_SEQUENTIAL_WRITES OTA_SIZE_UNKNOWN
+#endif
+
+float OtaStats::writeThroughputKBps() const {
+    if (flashWriteMs == 0) {
+        return 0.0f;
+    }
+    return (imageBytes / 1024.0f) / (flashWriteMs / 1000.0f);
+}
+
+float OtaStats::compressionRatio() const {
+    if (payloadBytes == 0) {
+        return 0.0f;
+    }
+    return static_cast<float>(imageBytes) / payloadBytes;
+}
+
+OtaUpdater::OtaUpdater()
+    : _pControlChar(nullptr)
+    , _pDataChar(nullptr)
+    , _bufferPool(nullptr)
+    , _freeQueue(nullptr)
+    , _filledQueue(nullptr)
+    , _writerTask(nullptr)
+    , _fillChunk{nullptr, 0}
+    , _status(OTA_STATUS_IDLE)
+    , _error(OtaError::NONE)
+    , _notifiedStatus(OTA_STATUS_IDLE)
+    , _busy(false)
+    , _refused(false)
+    , _inputClosed(true)
+    , _writerIdle(true)
+    , _expectedPayload(0)
+    , _receivedPayload(0)
+    , _lastActivity(0)
+    , _startTime(0)
+    , _successTime(0)
+    , _signatureLength(0)
+    , _targetPartition(nullptr)
+    , _otaHandle(0)
+    , _otaStarted(false)
+    , _isDelta(false)
+    , _imageWritten(0)
+    , _flashWriteUs(0)
+    , _pendingVerify(false)
+    , _stats{}
+    , _httpOwned(false)
+    , _httpCancel(false) {
+}
+
+void OtaUpdater::begin() {
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    Serial.printf("[OTA] Running from partition '%s'\n", running->label);
+
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK &&
+        state == ESP_OTA_IMG_PENDING_VERIFY) {
+        _pendingVerify = true;
+        Serial.printf("[OTA] New image pending verification (rollback in %d s)\n",
+                      OTA_ROLLBACK_TIMEOUT_MS / 1000);
+    }
+}
+
+void OtaUpdater::setupService(NimBLEServer* pServer) {
+    NimBLEService* pService = pServer->createService(SERVICE_UUID_OTA);
+
+    // Control characteristic - Read/Write/Notify
+    _pControlChar = pService->createCharacteristic(
+        CHAR_UUID_OTA_CONTROL,
+        NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY
+    );
+    _pControlChar->setCallbacks(this);
+
+    // Data characteristic - Write without response for bulk transfer
+    _pDataChar = pService->createCharacteristic(
+        CHAR_UUID_OTA_DATA,
+        NIMBLE_PROPERTY::WRITE_NR
+    );
+    _pDataChar->setCallbacks(this);
+
+    uint8_t status[2] = { OTA_STATUS_IDLE, static_cast<uint8_t>(OtaError::NONE) };
+    _pControlChar->setValue(status, sizeof(status));
+
+    pService->start();
+    Serial.println("[OTA] GATT service started");
+}
+
+void OtaUpdater::poll() {
+    // Rollback if the new image never confirmed a healthy boot
+    if (_pendingVerify && millis() > OTA_ROLLBACK_TIMEOUT_MS) {
+        Serial.println("[OTA] Boot not confirmed in time, rolling back");
+        delay(100);
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+    }
+
+    // Abort a transfer that stopped delivering data
+    if (_status == OTA_STATUS_RECEIVING && (millis() - _lastActivity > OTA_IDLE_TIMEOUT_MS)) {
+        Serial.println("[OTA] Transfer stalled");
+        fail(OtaError::TIMEOUT);
+        closeInput(false);
+    }
+
+    // Status notifications are sent from loop context only. A refused GATT
+    // write is always answered with BUSY, even if the buffers freed up
+    // meanwhile, and followed by RECEIVING once writes are taken again
+    if (_refused.exchange(false) && _status == OTA_STATUS_RECEIVING) {
+        _notifiedStatus = OTA_STATUS_BUSY;
+        notifyStatus();
+    }
+
+    uint8_t status = reportedStatus();
+    if (status != _notifiedStatus) {
+        _notifiedStatus = status;
+        notifyStatus();
+
+        if (_status == OTA_STATUS_SUCCESS || _status == OTA_STATUS_ERROR) {
+            reportStats();
+        }
+        if (_status == OTA_STATUS_SUCCESS) {
+            _successTime = millis();
+        }
+    }
+
+    if (_status == OTA_STATUS_SUCCESS && (millis() - _successTime > OTA_REBOOT_DELAY_MS)) {
+        Serial.println("[OTA] Rebooting into new firmware");
+        delay(100);
+        ESP.restart();
+    }
+}
+
+void OtaUpdater::confirmBoot() {
+    if (!_pendingVerify) {
+        return;
+    }
+
+    _pendingVerify = false;
+    if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK) {
+        Serial.println("[OTA] Boot confirmed, rollback cancelled");
+    } else {
+        Serial.println("[OTA] Failed to confirm boot");
+    }
+}
+
+bool OtaUpdater::isActive() const {
+    return _status == OTA_STATUS_RECEIVING ||
+           _status == OTA_STATUS_VERIFYING ||
+           _status == OTA_STATUS_SUCCESS;
+}
+
+void OtaUpdater::abort() {
+    if (_status == OTA_STATUS_RECEIVING) {
+        Serial.println("[OTA] Aborted");
+        fail(OtaError::ABORTED);
+        closeInput(false);
+        return;
+    }
+
+    // The HTTP task checks this before it opens the session
+    if (_httpOwned) {
+        Serial.println("[OTA] Aborted before download started");
+        _httpCancel = true;
+        fail(OtaError::ABORTED);
+    }
+}
+
+// =============================================================================
+// Session Control
+// =============================================================================
+
+bool OtaUpdater::allocatePipeline() {
+    if (_bufferPool) {
+        return true;
+    }
+
+    // Buffers and writer task are created on first use and kept for later updates
+    const size_t poolSize = OTA_CHUNK_SIZE * OTA_PIPELINE_DEPTH;
+    _bufferPool = static_cast<uint8_t*>(heap_caps_malloc(poolSize, MALLOC_CAP_SPIRAM));
+    if (!_bufferPool) {
+        _bufferPool = static_cast<uint8_t*>(malloc(poolSize));
+    }
+
+    _freeQueue = xQueueCreate(OTA_PIPELINE_DEPTH, sizeof(Chunk));
+    _filledQueue = xQueueCreate(OTA_PIPELINE_DEPTH + 1, sizeof(Chunk));  // +1 for end marker
+
+    if (!_bufferPool || !_freeQueue || !_filledQueue ||
+        xTaskCreate(writerTaskEntry, "ota_writer", 8192, this, 5, &_writerTask) != pdPASS) {
+        Serial.println("[OTA] Failed to allocate pipeline");
+        return false;
+    }
+
+    return true;
+}
+
+bool OtaUpdater::startSession(uint32_t expectedPayload, bool http) {
+    if (isActive() || !_writerIdle || (_httpOwned && !http)) {
+        Serial.println("[OTA] Update already in progress");
+        return false;
+    }
+
+    _stats = OtaStats{};
+    _error = OtaError::NONE;
+
+    if (expectedPayload == 0) {
+        fail(OtaError::SIZE_MISMATCH);
+        return false;
+    }
+
+    _targetPartition = esp_ota_get_next_update_partition(nullptr);
+    if (!_targetPartition) {
+        Serial.println("[OTA] No OTA partition available");
+        fail(OtaError::NO_PARTITION);
+        return false;
+    }
+
+    if (!allocatePipeline()) {
+        fail(OtaError::NO_MEMORY);
+        return false;
+    }
+
+    // Hand all buffers back to the free queue
+    xQueueReset(_freeQueue);
+    xQueueReset(_filledQueue);
+    for (uint8_t i = 0; i < OTA_PIPELINE_DEPTH; i++) {
+        Chunk chunk = { _bufferPool + i * OTA_CHUNK_SIZE, 0 };
+        xQueueSend(_freeQueue, &chunk, 0);
+    }
+
+    _fillChunk = { nullptr, 0 };
+    _busy = false;
+    _refused = false;
+    _expectedPayload = expectedPayload;
+    _receivedPayload = 0;
+    _signatureLength = 0;
+    _otaStarted = false;
+    _isDelta = false;
+    _imageWritten = 0;
+    _flashWriteUs = 0;
+    _startTime = millis();
+    _lastActivity = _startTime;
+    _writerIdle = false;
+    _inputClosed = false;
+    _status = OTA_STATUS_RECEIVING;
+
+    Serial.printf("[OTA] Receiving %u bytes into partition '%s'\n",
+                  expectedPayload, _targetPartition->label);
+    return true;
+}
+
+void OtaUpdater::fail(OtaError error) {
+    if (_error == OtaError::NONE) {
+        _error = error;
+        Serial.printf("[OTA] Failed with error 0x%02X\n", static_cast<uint8_t>(error));
+    }
+    _status = OTA_STATUS_ERROR;
+}
+
+void OtaUpdater::closeInput(bool flush) {
+    if (_inputClosed.exchange(true)) {
+        return;
+    }
+
+    if (flush && _fillChunk.data && _fillChunk.length > 0) {
+        xQueueSend(_filledQueue, &_fillChunk, portMAX_DELAY);
+        _fillChunk = { nullptr, 0 };
+    }
+
+    // The filled queue has one spare slot, so the end marker always fits
+    Chunk endMarker = { nullptr, 0 };
+    xQueueSend(_filledQueue, &endMarker, portMAX_DELAY);
+}
+
+// =============================================================================
+// Transport Side
+// =============================================================================
+
+bool OtaUpdater::appendPayload(const uint8_t* data, size_t length, TickType_t wait) {
+    if (_inputClosed || _status != OTA_STATUS_RECEIVING) {
+        return false;
+    }
+
+    if (length > _expectedPayload - _receivedPayload) {
+        Serial.println("[OTA] Received more data than announced");
+        fail(OtaError::SIZE_MISMATCH);
+        closeInput(false);
+        return false;
+    }
+
+    // Without a wait budget the write is taken whole or not at all, so the
+    // client can resend it from the notified offset once buffers free up
+    if (wait == 0) {
+        size_t room = _fillChunk.data ? OTA_CHUNK_SIZE - _fillChunk.length : 0;
+        UBaseType_t needed = length > room ? (length - room + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE : 0;
+        if (uxQueueMessagesWaiting(_freeQueue) < needed) {
+            _busy = true;
+            // The writer may have freed a buffer before it could see _busy
+            if (uxQueueMessagesWaiting(_freeQueue) >= needed) {
+                _busy = false;
+            }
+            refuseWrite();
+            return false;
+        }
+    }
+
+    _receivedPayload += length;
+    _lastActivity = millis();
+
+    while (length > 0) {
+        if (!_fillChunk.data) {
+            // The HTTP task blocks while all buffers are queued for flashing
+            if (xQueueReceive(_freeQueue, &_fillChunk, wait) != pdTRUE) {
+                _fillChunk = { nullptr, 0 };
+                fail(OtaError::TIMEOUT);
+                closeInput(false);
+                return false;
+            }
+            _fillChunk.length = 0;
+        }
+
+        size_t n = OTA_CHUNK_SIZE - _fillChunk.length;
+        if (n > length) {
+            n = length;
+        }
+        memcpy(_fillChunk.data + _fillChunk.length, data, n);
+        _fillChunk.length += n;
+        data += n;
+        length -= n;
+
+        if (_fillChunk.length == OTA_CHUNK_SIZE) {
+            xQueueSend(_filledQueue, &_fillChunk, portMAX_DELAY);
+            _fillChunk = { nullptr, 0 };
+        }
+    }
+
+    return true;
+}
+
+void OtaUpdater::refuseWrite() {
+    _refused = true;
+    PowerManager::wake();
+}
+
+bool OtaUpdater::finishPayload(const uint8_t* signature, size_t signatureLength) {
+    if (_inputClosed || _status != OTA_STATUS_RECEIVING) {
+        return false;
+    }
+
+    if (_receivedPayload != _expectedPayload) {
+        Serial.printf("[OTA] Payload incomplete: %u of %u bytes\n", _receivedPayload, _expectedPayload);
+        fail(OtaError::SIZE_MISMATCH);
+        closeInput(false);
+        return false;
+    }
+
+    if (signatureLength == 0 || signatureLength > MAX_SIGNATURE_LENGTH) {
+        Serial.println("[OTA] Missing or oversized signature");
+        fail(OtaError::BAD_SIGNATURE);
+        closeInput(false);
+        return false;
+    }
+
+    memcpy(_signature, signature, signatureLength);
+    _signatureLength = signatureLength;
+    closeInput(true);
+    return true;
+}
+
+void OtaUpdater::handleControl(const std::string& value) {
+    if (value.empty()) {
+        return;
+    }
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(value.data());
+    uint8_t cmd = bytes[0];
+    Serial.printf("[OTA] Command received: 0x%02X\n", cmd);
+
+    switch (cmd) {
+        case OTA_CMD_BEGIN: {
+            if (value.length() < 5) {
+                Serial.println("[OTA] BEGIN without payload size");
+                break;
+            }
+            uint32_t size = (uint32_t)bytes[1] | ((uint32_t)bytes[2] << 8) |
+                            ((uint32_t)bytes[3] << 16) | ((uint32_t)bytes[4] << 24);
+            startSession(size);
+            break;
+        }
+
+        case OTA_CMD_END:
+            // A short payload after a refused write is resent, not a failure
+            if (_status == OTA_STATUS_RECEIVING && _receivedPayload < _expectedPayload) {
+                refuseWrite();
+                break;
+            }
+            finishPayload(bytes + 1, value.length() - 1);
+            break;
+
+        case OTA_CMD_ABORT:
+            abort();
+            break;
+
+        case OTA_CMD_BEGIN_HTTP:
+            beginHttp(String(value.substr(1).c_str()));
+            break;
+
+        default:
+            Serial.printf("[OTA] Unknown command: 0x%02X\n", cmd);
+            break;
+    }
+}
+
+// =============================================================================
+// Writer Side
+// =============================================================================
+
+void OtaUpdater::writerTaskEntry(void* arg) {
+    static_cast<OtaUpdater*>(arg)->writerLoop();
+}
+
+void OtaUpdater::writerLoop() {
+    Chunk chunk;
+
+    for (;;) {
+        xQueueReceive(_filledQueue, &chunk, portMAX_DELAY);
+
+        if (chunk.length > 0) {
+            // After a failure keep draining so the transport never blocks
+            if (_error == OtaError::NONE && !consumeChunk(chunk.data, chunk.length)) {
+                closeInput(false);
+            }
+            chunk.length = 0;
+            xQueueSend(_freeQueue, &chunk, portMAX_DELAY);
+
+            // Tell a GATT client that backed off it can resume
+            if (_busy.exchange(false)) {
+                PowerManager::wake();
+            }
+            continue;
+        }
+
+        // End of stream
+        if (_error == OtaError::NONE && finalizeImage()) {
+            _status = OTA_STATUS_SUCCESS;
+        } else {
+            cleanupImage();
+        }
+        _writerIdle = true;
+
+        // Let loop() send the final status notification right away
+        PowerManager::wake();
+    }
+}
+
+bool OtaUpdater::consumeChunk(const uint8_t* data, size_t length) {
+    if (!_otaStarted) {
+        _isDelta = DeltaPatcher::isDelta(data, length);
+
+        esp_err_t err = esp_ota_begin(_targetPartition, OTA_WITH_SEQUENTIAL_WRITES, &_otaHandle);
+        if (err != ESP_OK) {
+            Serial.printf("[OTA] esp_ota_begin failed: %s\n", esp_err_to_name(err));
+            fail(OtaError::FLASH_WRITE);
+            return false;
+        }
+        _otaStarted = true;
+
+        mbedtls_md_init(&_hashCtx);
+        mbedtls_md_setup(&_hashCtx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+        mbedtls_md_starts(&_hashCtx);
+
+        if (_isDelta) {
+            Serial.println("[OTA] Delta patch detected");
+            _baseImage.setPartition(esp_ota_get_running_partition());
+            _patcher.begin(&_baseImage,
+                           [this](const uint8_t* out, size_t n) { return writeImage(out, n); });
+        }
+    }
+
+    if (_isDelta) {
+        if (!_patcher.feed(data, length)) {
+            if (_error == OtaError::NONE) {
+                Serial.printf("[Delta] %s\n", _patcher.getError());
+                fail(OtaError::BAD_DELTA);
+            }
+            return false;
+        }
+        return true;
+    }
+
+    return writeImage(data, length);
+}
+
+bool OtaUpdater::writeImage(const uint8_t* data, size_t length) {
+    unsigned long start = micros();
+    esp_err_t err = esp_ota_write(_otaHandle, data, length);
+    _flashWriteUs += micros() - start;
+
+    if (err != ESP_OK) {
+        Serial.printf("[OTA] esp_ota_write failed: %s\n", esp_err_to_name(err));
+        fail(OtaError::FLASH_WRITE);
+        return false;
+    }
+
+    mbedtls_md_update(&_hashCtx, data, length);
+    _imageWritten += length;
+    return true;
+}
+
+bool OtaUpdater::finalizeImage() {
+    _status = OTA_STATUS_VERIFYING;
+
+    if (!_otaStarted || (_isDelta && !_patcher.isComplete()) ||
+        (!_isDelta && _imageWritten != _expectedPayload)) {
+        Serial.println("[OTA] Image incomplete");
+        fail(_isDelta ? OtaError::BAD_DELTA : OtaError::SIZE_MISMATCH);
+        return false;
+    }
+
+    uint8_t hash[32];
+    mbedtls_md_finish(&_hashCtx, hash);
+    mbedtls_md_free(&_hashCtx);
+
+    _stats.payloadBytes = _receivedPayload;
+    _stats.imageBytes = _imageWritten;
+    _stats.flashWriteMs = _flashWriteUs / 1000;
+    _stats.delta = _isDelta;
+
+    if (!verifySignature(hash)) {
+        fail(OtaError::BAD_SIGNATURE);
+        esp_ota_abort(_otaHandle);
+        _otaStarted = false;
+        return false;
+    }
+
+    // esp_ota_end validates the image structure and checksum
+    esp_err_t err = esp_ota_end(_otaHandle);
+    _otaStarted = false;
+    if (err != ESP_OK) {
+        Serial.printf("[OTA] esp_ota_end failed: %s\n", esp_err_to_name(err));
+        fail(OtaError::INVALID_IMAGE);
+        return false;
+    }
+
+    err = esp_ota_set_boot_partition(_targetPartition);
+    if (err != ESP_OK) {
+        Serial.printf("[OTA] Set boot partition failed: %s\n", esp_err_to_name(err));
+        fail(OtaError::FLASH_WRITE);
+        return false;
+    }
+
+    _stats.transferMs = millis() - _startTime;
+    return true;
+}
+
+void OtaUpdater::cleanupImage() {
+    if (_otaStarted) {
+        esp_ota_abort(_otaHandle);
+        mbedtls_md_free(&_hashCtx);
+        _otaStarted = false;
+    }
+
+    _stats.payloadBytes = _receivedPayload;
+    _stats.imageBytes = _imageWritten;
+    _stats.flashWriteMs = _flashWriteUs / 1000;
+    _stats.transferMs = millis() - _startTime;
+    _stats.delta = _isDelta;
+}
+
+bool OtaUpdater::PartitionImage::read(uint32_t offset, uint8_t* out, size_t length) {
+    return esp_partition_read(_partition, offset, out, length) == ESP_OK;
+}
+
+bool OtaUpdater::PartitionImage::sha256(uint8_t* out) {
+    // For app partitions this is the digest appended to the image
+    return esp_partition_get_sha256(_partition, out) == ESP_OK;
+}
+
+bool OtaUpdater::verifySignature(const uint8_t* hash) {
+    static const char pubKey[] = OTA_SIGNING_PUBKEY_PEM;
+
+    mbedtls_pk_context pk;
+    mbedtls_pk_init(&pk);
+
+    bool valid = false;
+    int ret = mbedtls_pk_parse_public_key(&pk, reinterpret_cast<const unsigned char*>(pubKey),
+                                          sizeof(pubKey));
+    if (ret != 0) {
+        Serial.printf("[OTA] Invalid signing key (-0x%04X)\n", -ret);
+    } else {
+        ret = mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, hash, 32, _signature, _signatureLength);
+        valid = (ret == 0);
+        Serial.println(valid ? "[OTA] Signature verified" : "[OTA] Signature check failed");
+    }
+
+    mbedtls_pk_free(&pk);
+    return valid;
+}
+
+// =============================================================================
+// HTTP Transport
+// =============================================================================
+
+bool OtaUpdater::beginHttp(const String& url) {
+    if (isActive() || !_writerIdle || _httpOwned) {
+        Serial.println("[OTA] Update already in progress");
+        return false;
+    }
+
+    if (url.length() == 0 || url.length() > OTA_MAX_URL_LENGTH) {
+        Serial.println("[OTA] Invalid firmware URL");
+        return false;
+    }
+
+    // Claim the session now - fetching the signature takes a while and a
+    // GATT BEGIN in the meantime must not start a second session
+    _httpUrl = url;
+    _httpOwned = true;
+    _httpCancel = false;
+    _error = OtaError::NONE;
+    if (xTaskCreate(httpTaskEntry, "ota_http", 8192, this, 4, nullptr) != pdPASS) {
+        _httpOwned = false;
+        fail(OtaError::NO_MEMORY);
+        return false;
+    }
+
+    return true;
+}
+
+void OtaUpdater::httpTaskEntry(void* arg) {
+    OtaUpdater* updater = static_cast<OtaUpdater*>(arg);
+    updater->httpDownload();
+    updater->_httpOwned = false;
+    vTaskDelete(nullptr);
+}
+
+void OtaUpdater::httpDownload() {
+    HTTPClient http;
+    uint8_t signature[MAX_SIGNATURE_LENGTH];
+    size_t signatureLength = 0;
+
+    // Detached signature sits next to the image
+    Serial.printf("[OTA] Fetching signature: %s.sig\n", _httpUrl.c_str());
+    http.begin(_httpUrl + ".sig");
+    if (http.GET() == HTTP_CODE_OK) {
+        WiFiClient* stream = http.getStreamPtr();
+        int size = http.getSize();
+        if (size > 0 && size <= (int)MAX_SIGNATURE_LENGTH) {
+            signatureLength = stream->readBytes(signature, size);
+        }
+    }
+    http.end();
+
+    if (_httpCancel) {
+        return;
+    }
+
+    if (signatureLength == 0) {
+        Serial.println("[OTA] Signature download failed");
+        fail(OtaError::BAD_SIGNATURE);
+        return;
+    }
+
+    Serial.printf("[OTA] Downloading: %s\n", _httpUrl.c_str());
+    http.begin(_httpUrl);
+    int code = http.GET();
+    int size = http.getSize();
+    if (code != HTTP_CODE_OK || size <= 0) {
+        Serial.printf("[OTA] HTTP GET failed: %d (size %d)\n", code, size);
+        http.end();
+        fail(OtaError::DOWNLOAD);
+        return;
+    }
+
+    if (_httpCancel || !startSession(size, true)) {
+        http.end();
+        return;
+    }
+
+    WiFiClient* stream = http.getStreamPtr();
+    uint8_t buffer[1024];
+    int remaining = size;
+
+    while (remaining > 0 && _status == OTA_STATUS_RECEIVING && !_httpCancel) {
+        size_t want = remaining < (int)sizeof(buffer) ? remaining : sizeof(buffer);
+        size_t n = stream->readBytes(buffer, want);
+        if (n == 0) {
+            Serial.println("[OTA] HTTP stream ended early");
+            fail(OtaError::DOWNLOAD);
+            closeInput(false);
+            break;
+        }
+        if (!appendPayload(buffer, n, pdMS_TO_TICKS(OTA_BUFFER_WAIT_MS))) {
+            break;
+        }
+        remaining -= n;
+    }
+
+    http.end();
+
+    // abort() can land between the last check and startSession()
+    if (_httpCancel) {
+        fail(OtaError::ABORTED);
+        closeInput(false);
+        return;
+    }
+
+    if (remaining == 0) {
+        finishPayload(signature, signatureLength);
+    }
+}
+
+// =============================================================================
+// Status
+// =============================================================================
+
+uint8_t OtaUpdater::reportedStatus() const {
+    return (_status == OTA_STATUS_RECEIVING && _busy) ? OTA_STATUS_BUSY : _status;
+}
+
+void OtaUpdater::notifyStatus() {
+    if (!_pControlChar) {
+        return;
+    }
+
+    // [status][error][u32 payload bytes accepted] - BUSY clients resume from the offset
+    uint8_t status[6] = { _notifiedStatus, static_cast<uint8_t>(_error) };
+    uint32_t accepted = _receivedPayload;
+    memcpy(status + 2, &accepted, sizeof(accepted));  // ESP32 is little-endian
+    _pControlChar->setValue(status, sizeof(status));
+    _pControlChar->notify();
+    Serial.printf("[OTA] Status notified: %d (error 0x%02X, %u bytes)\n", status[0], status[1], accepted);
+}
+
+void OtaUpdater::reportStats() {
+    Serial.printf("[OTA] %s: %u payload bytes -> %u image bytes in %.1f s\n",
+                  _status == OTA_STATUS_SUCCESS ? "Update complete" : "Update failed",
+                  _stats.payloadBytes, _stats.imageBytes, _stats.transferMs / 1000.0f);
+    Serial.printf("[OTA] Flash write: %u ms, %.1f KiB/s\n",
+                  _stats.flashWriteMs, _stats.writeThroughputKBps());
+    if (_stats.delta) {
+        Serial.printf("[OTA] Delta compression ratio: %.2fx\n", _stats.compressionRatio());
+    }
+}
+
+// =============================================================================
+// NimBLE Callbacks (NimBLE 1.4.x signatures)
+// =============================================================================
+
+void OtaUpdater::onWrite(NimBLECharacteristic* pCharacteristic) {
+    std::string value = pCharacteristic->getValue();
+
+    // GATT transfers are refused while an HTTP download owns the session
+    if (_httpOwned && !(pCharacteristic == _pControlChar && !value.empty() && value[0] == OTA_CMD_ABORT)) {
+        Serial.println("[OTA] HTTP update in progress, ignoring write");
+        return;
+    }
+
+    if (pCharacteristic == _pDataChar) {
+        // [u32 payload offset][data] - writes still in flight after a refused
+        // one arrive at the wrong offset and are dropped as well
+        if (value.length() < 4) {
+            return;
+        }
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(value.data());
+        uint32_t offset = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+                          ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+        if (_status == OTA_STATUS_RECEIVING && offset != _receivedPayload) {
+            refuseWrite();
+            return;
+        }
+
+        // Runs on the NimBLE host task, so never wait for a buffer here
+        appendPayload(bytes + 4, value.length() - 4, 0);
+    }
+    else if (pCharacteristic == _pControlChar) {
+        handleControl(value);
+    }
+}
+
+void OtaUpdater::onRead(NimBLECharacteristic* pCharacteristic) {
+    if (pCharacteristic != _pControlChar) {
+        return;
+    }
+
+    // [status][error][u32 payload][u32 image][u32 transfer ms][u32 flash ms][u8 delta]
+    uint8_t report[19];
+    report[0] = _status;
+    report[1] = static_cast<uint8_t>(_error);
+    uint32_t fields[4] = {
+        _stats.payloadBytes, _stats.imageBytes, _stats.transferMs, _stats.flashWriteMs
+    };
+    memcpy(report + 2, fields, sizeof(fields));  // ESP32 is little-endian
+    report[18] = _stats.delta ? 1 : 0;
+    pCharacteristic->setValue(report, sizeof(report));
+}
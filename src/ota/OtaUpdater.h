@@ -0,0 +1,210 @@
+#ifndef OTA_UPDATER_H
+#define OTA_UPDATER_H
+
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include <esp_ota_ops.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <mbedtls/md.h>
+#include <atomic>
+#include "../provisioning/BLEProvisioning.h"
+#include "DeltaPatcher.h"
+
+/**
+ * OTA error codes (second byte of the OTA Control status)
+ */
+enum class OtaError : uint8_t {
+    NONE              = 0x00,
+    NO_PARTITION      = 0x01,  // No inactive OTA partition available
+    NO_MEMORY         = 0x02,  // Pipeline buffers or tasks could not be allocated
+    FLASH_WRITE       = 0x03,  // esp_ota_begin/write failed
+    TIMEOUT           = 0x04,  // Transfer stalled or flash writer fell behind
+    SIZE_MISMATCH     = 0x05,  // Received byte count differs from announced
+    BAD_DELTA         = 0x06,  // Malformed patch or wrong base image
+    BAD_SIGNATURE     = 0x07,  // Signature missing or does not verify
+    INVALID_IMAGE     = 0x08,  // esp_ota_end rejected the image
+    DOWNLOAD          = 0x09,  // HTTP request failed
+    ABORTED           = 0x0A   // Cancelled by client
+};
+
+/**
+ * Statistics for the most recent update
+ */
+struct OtaStats {
+    uint32_t payloadBytes;    // Bytes received over the transport
+    uint32_t imageBytes;      // Bytes written to the OTA partition
+    uint32_t transferMs;      // BEGIN to verified image
+    uint32_t flashWriteMs;    // Time spent inside esp_ota_write
+    bool     delta;           // Payload was a delta patch
+
+    /** Flash write throughput in KiB/s */
+    float writeThroughputKBps() const;
+
+    /** Image bytes per payload byte (1.0 for full images) */
+    float compressionRatio() const;
+};
+
+/**
+ * OtaUpdater - Streaming firmware update into the inactive app partition
+ *
+ * Firmware arrives either over the OTA GATT service or over HTTP. The
+ * transport fills fixed-size chunk buffers that a dedicated writer task
+ * drains into flash, so receiving the next chunk overlaps the flash write
+ * of the previous one. Payloads starting with the delta magic are patched
+ * against the running image on the fly. The resulting image must carry a
+ * valid ECDSA signature before it is made bootable.
+ *
+ * A freshly updated image boots in pending-verify state and is rolled back
+ * unless confirmBoot() is called within OTA_ROLLBACK_TIMEOUT_MS.
+ */
+class OtaUpdater : public BLEServiceProvider,
+                   public NimBLECharacteristicCallbacks {
+public:
+    OtaUpdater();
+
+    /**
+     * Check rollback state of the running image
+     * Must be called once from setup()
+     */
+    void begin();
+
+    /**
+     * Must be called in main loop - notifies status, handles reboot and rollback
+     */
+    void poll();
+
+    /**
+     * Mark the running image as good and cancel rollback
+     * Call once the firmware has proven itself (e.g. WiFi connected)
+     */
+    void confirmBoot();
+
+    /**
+     * Start downloading firmware over HTTP (signature is fetched from url + ".sig")
+     * @return false if an update is already in progress
+     */
+    bool beginHttp(const String& url);
+
+    /**
+     * Cancel the update in progress, including an HTTP download that is
+     * still fetching its signature
+     */
+    void abort();
+
+    /**
+     * Check if an update is in progress
+     */
+    bool isActive() const;
+
+    /**
+     * Statistics of the last completed or failed update
+     */
+    const OtaStats& getStats() const { return _stats; }
+
+    // BLEServiceProvider
+    void setupService(NimBLEServer* pServer) override;
+
+    // NimBLECharacteristicCallbacks (NimBLE 1.4.x signatures)
+    void onWrite(NimBLECharacteristic* pCharacteristic) override;
+    void onRead(NimBLECharacteristic* pCharacteristic) override;
+
+private:
+    struct Chunk {
+        uint8_t* data;
+        size_t length;      // 0 marks end of stream
+    };
+
+    /**
+     * Running app partition as the base of a delta patch
+     */
+    class PartitionImage : public DeltaPatcher::BaseImage {
+    public:
+        void setPartition(const esp_partition_t* partition) { _partition = partition; }
+
+        uint32_t size() const override { return _partition->size; }
+        bool read(uint32_t offset, uint8_t* out, size_t length) override;
+        bool sha256(uint8_t* out) override;
+
+    private:
+        const esp_partition_t* _partition = nullptr;
+    };
+
+    // BLE objects
+    NimBLECharacteristic* _pControlChar;
+    NimBLECharacteristic* _pDataChar;
+
+    // Pipeline
+    uint8_t* _bufferPool;
+    QueueHandle_t _freeQueue;
+    QueueHandle_t _filledQueue;
+    TaskHandle_t _writerTask;
+    Chunk _fillChunk;           // Buffer currently being filled by the transport
+
+    // Update session
+    static constexpr size_t MAX_SIGNATURE_LENGTH = 72;  // DER-encoded P-256
+    volatile uint8_t _status;
+    volatile OtaError _error;
+    uint8_t _notifiedStatus;
+    std::atomic<bool> _busy;    // No free buffer for GATT writes, cleared by the writer
+    std::atomic<bool> _refused; // A GATT write was dropped and the client not yet told
+    std::atomic<bool> _inputClosed;
+    volatile bool _writerIdle;
+    uint32_t _expectedPayload;
+    uint32_t _receivedPayload;
+    volatile unsigned long _lastActivity;
+    unsigned long _startTime;
+    unsigned long _successTime;
+    uint8_t _signature[MAX_SIGNATURE_LENGTH];
+    size_t _signatureLength;
+
+    // Writer task state
+    const esp_partition_t* _targetPartition;
+    esp_ota_handle_t _otaHandle;
+    bool _otaStarted;
+    bool _isDelta;
+    uint32_t _imageWritten;
+    uint32_t _flashWriteUs;
+    mbedtls_md_context_t _hashCtx;
+    DeltaPatcher _patcher;
+    PartitionImage _baseImage;
+
+    // Rollback
+    bool _pendingVerify;
+
+    OtaStats _stats;
+
+    // Session control
+    bool allocatePipeline();
+    bool startSession(uint32_t expectedPayload, bool http = false);
+    void fail(OtaError error);
+    void closeInput(bool flush);
+
+    // Transport side
+    bool appendPayload(const uint8_t* data, size_t length, TickType_t wait);
+    void refuseWrite();
+    bool finishPayload(const uint8_t* signature, size_t signatureLength);
+    void handleControl(const std::string& value);
+
+    // Writer side
+    static void writerTaskEntry(void* arg);
+    void writerLoop();
+    bool consumeChunk(const uint8_t* data, size_t length);
+    bool writeImage(const uint8_t* data, size_t length);
+    bool finalizeImage();
+    void cleanupImage();
+    bool verifySignature(const uint8_t* hash);
+
+    // HTTP transport
+    static void httpTaskEntry(void* arg);
+    void httpDownload();
+    String _httpUrl;
+    volatile bool _httpOwned;   // HTTP task owns the session from beginHttp() until it exits
+    volatile bool _httpCancel;  // abort() arrived while the HTTP task was still starting
+
+    uint8_t reportedStatus() const;
+    void notifyStatus();
+    void reportStats();
+};
+
+#endif // OTA_UPDATER_H
@@ -0,0 +1,433 @@
+#include "PowerManager.h"
+#include "../config.h"
+#include <WiFi.h>
+#include <esp_idf_version.h>
+#include <esp_pm.h>
+#include <esp_wifi.h>
+
+TaskHandle_t PowerManager::s_loopTask = nullptr;
+portMUX_TYPE PowerManager::s_probeMux = portMUX_INITIALIZER_UNLOCKED;
+int64_t PowerManager::s_probeFiredUs = 0;
+
+PowerManager::PowerManager(BLEProvisioning& provisioning)
+    : _provisioning(provisioning)
+    , _pProfileChar(nullptr)
+    , _pStatsChar(nullptr)
+    , _pEchoChar(nullptr)
+    , _profile(PowerProfile::BALANCED)
+    , _requestedProfile(POWER_PROFILE_BALANCED)
+    , _loopPeriodMs(POWER_LOOP_PERIOD_BALANCED_MS)
+    , _lightSleepConfigured(false)
+    , _wifiPs(WIFI_PS_MIN_MODEM)
+    , _wifiPsActive(WIFI_PS_UNKNOWN)
+    , _wakeLatencyUs(0)
+    , _maxWakeLatencyUs(0)
+    , _probeTimer(nullptr)
+    , _probeArmed(false)
+    , _probeValid(false)
+    , _probeDueUs(0)
+    , _nextProbe(0)
+    , _echoMux(portMUX_INITIALIZER_UNLOCKED)
+    , _echoPending(false)
+    , _echoRequestUs(0)
+    , _echoToken{}
+    , _echoLength(0)
+    , _queryLatencyUs{} {
+}
+
+void PowerManager::begin() {
+    s_loopTask = xTaskGetCurrentTaskHandle();
+
+    // WiFi events (connect, disconnect, scan done) should not wait for the loop period
+    WiFi.onEvent([this](WiFiEvent_t event, WiFiEventInfo_t) {
+        if (event == ARDUINO_EVENT_WIFI_STA_START) {
+            // Runs after the core applied its cached mode; make sure ours is
+            // the one in effect and report what the driver actually uses
+            esp_wifi_set_ps(_wifiPs);
+            readBackWiFi();
+            Serial.printf("[Power] WiFi power save in effect: %s\n", powerSaveName(_wifiPsActive));
+        }
+        PowerManager::wake();
+    });
+
+    esp_timer_create_args_t probeArgs = {};
+    probeArgs.callback = &PowerManager::onProbeTimer;
+    probeArgs.name = "wake_probe";
+    if (esp_timer_create(&probeArgs, &_probeTimer) != ESP_OK) {
+        Serial.println("[Power] Failed to create wake probe timer");
+        _probeTimer = nullptr;
+    }
+
+    uint8_t stored = POWER_PROFILE_BALANCED;
+    if (_preferences.begin(NVS_NAMESPACE_POWER, false)) {
+        stored = _preferences.getUChar(NVS_KEY_PROFILE, POWER_PROFILE_BALANCED);
+    } else {
+        Serial.println("[Power] Failed to open NVS namespace");
+    }
+
+    if (stored > POWER_PROFILE_LOW_POWER) {
+        stored = POWER_PROFILE_BALANCED;
+    }
+
+    _requestedProfile = stored;
+    applyProfile(static_cast<PowerProfile>(stored));
+}
+
+void PowerManager::poll() {
+    uint8_t requested = _requestedProfile;
+    if (requested != static_cast<uint8_t>(_profile)) {
+        setProfile(static_cast<PowerProfile>(requested));
+    }
+
+    answerEcho();
+}
+
+void PowerManager::waitForEvent() {
+    if (!s_loopTask) {
+        delay(_loopPeriodMs);
+        return;
+    }
+
+    if (_probeTimer && !_probeArmed && (long)(millis() - _nextProbe) >= 0) {
+        armProbe();
+    }
+
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(_loopPeriodMs));
+
+    if (_probeArmed) {
+        checkProbe();
+    }
+}
+
+void PowerManager::wake() {
+    if (s_loopTask) {
+        xTaskNotifyGive(s_loopTask);
+    }
+}
+
+// =============================================================================
+// Wake Latency Probe
+// =============================================================================
+
+void PowerManager::onProbeTimer(void*) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_probeMux);
+    s_probeFiredUs = now;
+    portEXIT_CRITICAL(&s_probeMux);
+
+    wake();
+}
+
+void PowerManager::armProbe() {
+    // Halfway through the wait the CPU is idle (in light sleep if enabled),
+    // so the timer alarm is what brings it back
+    uint64_t delayUs = static_cast<uint64_t>(_loopPeriodMs) * 500;
+
+    portENTER_CRITICAL(&s_probeMux);
+    s_probeFiredUs = 0;
+    portEXIT_CRITICAL(&s_probeMux);
+
+    _probeDueUs = esp_timer_get_time() + delayUs;
+    _probeValid = true;
+    _probeArmed = esp_timer_start_once(_probeTimer, delayUs) == ESP_OK;
+}
+
+void PowerManager::checkProbe() {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_probeMux);
+    int64_t fired = s_probeFiredUs;
+    s_probeFiredUs = 0;
+    portEXIT_CRITICAL(&s_probeMux);
+
+    if (fired == 0) {
+        // Woken by another event first - cancel and retry on the next wait.
+        // If the callback is already running, the loop was busy when the
+        // timer fired, so that sample does not measure a wake from idle.
+        if (esp_timer_stop(_probeTimer) == ESP_OK) {
+            _probeArmed = false;
+        } else {
+            _probeValid = false;
+        }
+        return;
+    }
+
+    _probeArmed = false;
+    _nextProbe = millis() + POWER_WAKE_PROBE_INTERVAL_MS;
+    if (!_probeValid) {
+        return;
+    }
+
+    uint32_t latency = static_cast<uint32_t>(now - _probeDueUs);
+
+    // EWMA with 1/8 weight for the newest sample
+    _wakeLatencyUs = _wakeLatencyUs == 0 ? latency : _wakeLatencyUs - (_wakeLatencyUs >> 3) + (latency >> 3);
+    if (latency > _maxWakeLatencyUs) {
+        _maxWakeLatencyUs = latency;
+    }
+}
+
+// =============================================================================
+// Status-Query Latency
+// =============================================================================
+
+void PowerManager::answerEcho() {
+    portENTER_CRITICAL(&_echoMux);
+    bool pending = _echoPending;
+    int64_t requestUs = _echoRequestUs;
+    uint8_t token[POWER_ECHO_MAX_LENGTH];
+    size_t length = _echoLength;
+    memcpy(token, _echoToken, length);
+    _echoPending = false;
+    portEXIT_CRITICAL(&_echoMux);
+
+    if (!pending || !_pEchoChar) {
+        return;
+    }
+
+    _pEchoChar->setValue(token, length);
+    _pEchoChar->notify();
+
+    uint32_t latency = static_cast<uint32_t>(esp_timer_get_time() - requestUs);
+    uint32_t& average = _queryLatencyUs[static_cast<uint8_t>(_profile)];
+
+    // EWMA with 1/8 weight for the newest sample
+    average = average == 0 ? latency : average - (average >> 3) + (latency >> 3);
+}
+
+uint32_t PowerManager::getQueryLatencyUs(PowerProfile profile) const {
+    uint8_t index = static_cast<uint8_t>(profile);
+    return index < POWER_PROFILE_COUNT ? _queryLatencyUs[index] : 0;
+}
+
+// =============================================================================
+// Profiles
+// =============================================================================
+
+void PowerManager::setProfile(PowerProfile profile) {
+    if (static_cast<uint8_t>(profile) > POWER_PROFILE_LOW_POWER) {
+        Serial.printf("[Power] Unknown profile: %d\n", static_cast<uint8_t>(profile));
+        _requestedProfile = static_cast<uint8_t>(_profile);
+        return;
+    }
+
+    _requestedProfile = static_cast<uint8_t>(profile);
+    applyProfile(profile);
+    _preferences.putUChar(NVS_KEY_PROFILE, static_cast<uint8_t>(profile));
+}
+
+const char* PowerManager::profileName(PowerProfile profile) {
+    switch (profile) {
+        case PowerProfile::MAX_PERFORMANCE: return "max-performance";
+        case PowerProfile::BALANCED:        return "balanced";
+        case PowerProfile::LOW_POWER:       return "low-power";
+    }
+    return "unknown";
+}
+
+const char* PowerManager::powerSaveName(uint8_t ps) {
+    switch (ps) {
+        case WIFI_PS_NONE:      return "none";
+        case WIFI_PS_MIN_MODEM: return "min-modem";
+        case WIFI_PS_MAX_MODEM: return "max-modem";
+    }
+    return "unknown";
+}
+
+uint16_t PowerManager::getNominalCurrentMa() const {
+    switch (_profile) {
+        case PowerProfile::MAX_PERFORMANCE:
+            return POWER_NOMINAL_MA_MAX_PERF;
+        case PowerProfile::BALANCED:
+            return POWER_NOMINAL_MA_BALANCED;
+        case PowerProfile::LOW_POWER:
+            // Without light sleep the hub behaves like the balanced profile
+            return _lightSleepConfigured ? POWER_NOMINAL_MA_LOW_POWER : POWER_NOMINAL_MA_BALANCED;
+    }
+    return POWER_NOMINAL_MA_MAX_PERF;
+}
+
+// =============================================================================
+// Profile Application
+// =============================================================================
+
+void PowerManager::applyProfile(PowerProfile profile) {
+    Serial.printf("[Power] Applying profile: %s\n", profileName(profile));
+
+    _profile = profile;
+    applyWiFi(profile);
+    applyCpu(profile);
+
+    switch (profile) {
+        case PowerProfile::MAX_PERFORMANCE:
+            _loopPeriodMs = POWER_LOOP_PERIOD_MAX_PERF_MS;
+            _provisioning.setRadioProfile(ESP_PWR_LVL_P9, POWER_ADV_MIN_MAX_PERF_MS, POWER_ADV_MAX_MAX_PERF_MS);
+            break;
+        case PowerProfile::BALANCED:
+            _loopPeriodMs = POWER_LOOP_PERIOD_BALANCED_MS;
+            _provisioning.setRadioProfile(ESP_PWR_LVL_P9, POWER_ADV_INTERVAL_BALANCED_MS, POWER_ADV_INTERVAL_BALANCED_MS);
+            break;
+        case PowerProfile::LOW_POWER:
+            _loopPeriodMs = POWER_LOOP_PERIOD_LOW_POWER_MS;
+            _provisioning.setRadioProfile(ESP_PWR_LVL_N0, POWER_ADV_INTERVAL_LOW_POWER_MS, POWER_ADV_INTERVAL_LOW_POWER_MS);
+            break;
+    }
+
+    resetLatencyStats();
+}
+
+void PowerManager::applyWiFi(PowerProfile profile) {
+    // Minimum modem sleep wakes for every DTIM beacon, so light sleep
+    // in the low-power profile stays aligned to the AP's DTIM period.
+    // WiFi/BLE coexistence requires modem sleep, and before the station
+    // starts the core only caches the mode without checking, so never ask
+    // for no power save while BLE is up
+    bool bleUp = NimBLEDevice::getInitialized();
+    _wifiPs = (profile == PowerProfile::MAX_PERFORMANCE && !bleUp) ? WIFI_PS_NONE : WIFI_PS_MIN_MODEM;
+    if (profile == PowerProfile::MAX_PERFORMANCE && bleUp) {
+        Serial.println("[Power] BLE is active, keeping WiFi modem sleep");
+    }
+
+    // Cached by the core and reapplied on STA_START (see begin())
+    WiFi.setSleep(_wifiPs);
+    readBackWiFi();
+}
+
+void PowerManager::readBackWiFi() {
+    // Fails until the WiFi driver is initialized
+    wifi_ps_type_t ps;
+    _wifiPsActive = esp_wifi_get_ps(&ps) == ESP_OK ? static_cast<uint8_t>(ps) : WIFI_PS_UNKNOWN;
+}
+
+void PowerManager::applyCpu(PowerProfile profile) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_pm_config_t config = {};
+#else
+    esp_pm_config_esp32s3_t config = {};
+#endif
+
+    config.max_freq_mhz = 240;
+    switch (profile) {
+        case PowerProfile::MAX_PERFORMANCE:
+            config.min_freq_mhz = 240;
+            config.light_sleep_enable = false;
+            break;
+        case PowerProfile::BALANCED:
+            config.min_freq_mhz = 80;
+            config.light_sleep_enable = false;
+            break;
+        case PowerProfile::LOW_POWER:
+            config.min_freq_mhz = 40;
+            config.light_sleep_enable = true;
+            break;
+    }
+
+    esp_err_t err = esp_pm_configure(&config);
+    if (err == ESP_ERR_NOT_SUPPORTED && config.light_sleep_enable) {
+        // Core built without tickless idle - keep frequency scaling at least
+        Serial.println("[Power] Automatic light sleep not supported by this build");
+        config.light_sleep_enable = false;
+        err = esp_pm_configure(&config);
+    }
+
+    _lightSleepConfigured = (err == ESP_OK) && config.light_sleep_enable;
+    if (err != ESP_OK) {
+        Serial.printf("[Power] esp_pm_configure failed: %s\n", esp_err_to_name(err));
+    }
+}
+
+void PowerManager::resetLatencyStats() {
+    _wakeLatencyUs = 0;
+    _maxWakeLatencyUs = 0;
+}
+
+// =============================================================================
+// BLE Service
+// =============================================================================
+
+void PowerManager::setupService(NimBLEServer* pServer) {
+    NimBLEService* pService = pServer->createService(SERVICE_UUID_POWER);
+
+    // Profile characteristic - Read/Write
+    _pProfileChar = pService->createCharacteristic(
+        CHAR_UUID_POWER_PROFILE,
+        NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE
+    );
+    _pProfileChar->setCallbacks(this);
+
+    // Stats characteristic - Read only
+    _pStatsChar = pService->createCharacteristic(
+        CHAR_UUID_POWER_STATS,
+        NIMBLE_PROPERTY::READ
+    );
+    _pStatsChar->setCallbacks(this);
+
+    // Echo characteristic - written token is notified back from loop()
+    _pEchoChar = pService->createCharacteristic(
+        CHAR_UUID_POWER_ECHO,
+        NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY
+    );
+    _pEchoChar->setCallbacks(this);
+
+    pService->start();
+}
+
+void PowerManager::onWrite(NimBLECharacteristic* pCharacteristic) {
+    if (pCharacteristic == _pEchoChar) {
+        // Timestamp first - everything after this counts as query latency
+        int64_t now = esp_timer_get_time();
+        std::string value = pCharacteristic->getValue();
+        size_t length = value.length() < POWER_ECHO_MAX_LENGTH ? value.length() : POWER_ECHO_MAX_LENGTH;
+
+        portENTER_CRITICAL(&_echoMux);
+        _echoRequestUs = now;
+        memcpy(_echoToken, value.data(), length);
+        _echoLength = length;
+        _echoPending = true;
+        portEXIT_CRITICAL(&_echoMux);
+
+        wake();
+        return;
+    }
+
+    if (pCharacteristic != _pProfileChar) {
+        return;
+    }
+
+    std::string value = pCharacteristic->getValue();
+    if (value.empty()) {
+        return;
+    }
+
+    uint8_t profile = static_cast<uint8_t>(value[0]);
+    Serial.printf("[Power] Profile requested over BLE: %d\n", profile);
+    if (profile > POWER_PROFILE_LOW_POWER) {
+        Serial.println("[Power] Ignoring unknown profile");
+        return;
+    }
+
+    // Applied from loop context (touches WiFi, PM and advertising)
+    _requestedProfile = profile;
+    wake();
+}
+
+void PowerManager::onRead(NimBLECharacteristic* pCharacteristic) {
+    if (pCharacteristic == _pProfileChar) {
+        uint8_t profile = static_cast<uint8_t>(_profile);
+        pCharacteristic->setValue(&profile, 1);
+    }
+    else if (pCharacteristic == _pStatsChar) {
+        // [profile][u32 wake latency avg us][u32 wake latency max us][u16 nominal mA]
+        // [u8 WiFi power save in effect][u32 query latency us per profile x 3]
+        uint8_t report[24];
+        report[0] = static_cast<uint8_t>(_profile);
+        uint32_t latency[2] = { _wakeLatencyUs, _maxWakeLatencyUs };
+        memcpy(report + 1, latency, sizeof(latency));  // ESP32 is little-endian
+        uint16_t current = getNominalCurrentMa();
+        memcpy(report + 9, &current, sizeof(current));
+        report[11] = _wifiPsActive;
+        memcpy(report + 12, _queryLatencyUs, sizeof(_queryLatencyUs));
+        pCharacteristic->setValue(report, sizeof(report));
+    }
+}
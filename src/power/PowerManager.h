@@ -0,0 +1,182 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include "../provisioning/BLEProvisioning.h"
+#include "../config.h"
+
+/**
+ * Power/latency profiles
+ */
+enum class PowerProfile : uint8_t {
+    MAX_PERFORMANCE = 0x00,  // Fixed 240 MHz, WiFi power save off unless BLE is up
+    BALANCED        = 0x01,  // Modem sleep, dynamic CPU frequency (default)
+    LOW_POWER       = 0x02   // DTIM-aligned light sleep, slow advertising
+};
+
+constexpr uint8_t POWER_PROFILE_COUNT = 3;
+
+/**
+ * PowerManager - Selectable power/latency profiles
+ *
+ * Applies WiFi power save, CPU frequency scaling / automatic light sleep
+ * and BLE advertising settings for the active profile. The profile is
+ * selected over BLE and persisted in NVS.
+ *
+ * Also replaces the fixed delay in loop(): waitForEvent() blocks until
+ * another module calls wake() or the profile's loop period expires, so the
+ * idle task can actually enter sleep between events.
+ *
+ * Wake latency is measured with a one-shot esp_timer armed halfway through
+ * an idle wait: with automatic light sleep the timer is the wake source, so
+ * the time from its alarm to loop() resuming includes leaving light sleep.
+ *
+ * Status-query latency is measured on the Echo characteristic: a client
+ * write is timestamped in the BLE callback and answered from loop(), so the
+ * figure covers waking the loop under the active profile. It is kept per
+ * profile, so the profiles can be compared after switching between them.
+ */
+class PowerManager : public BLEServiceProvider,
+                     public NimBLECharacteristicCallbacks {
+public:
+    /**
+     * Constructor
+     * @param provisioning Owner of BLE advertising settings
+     */
+    PowerManager(BLEProvisioning& provisioning);
+
+    /**
+     * Load the persisted profile and apply it
+     * Must be called from the loop task (setup) after BLE is started
+     */
+    void begin();
+
+    /**
+     * Must be called in main loop - applies profile changes requested over BLE
+     */
+    void poll();
+
+    /**
+     * Block until woken or the profile's loop period expires
+     * Call at the end of loop() instead of delay()
+     */
+    void waitForEvent();
+
+    /**
+     * Wake loop() early (safe to call from any task)
+     */
+    static void wake();
+
+    /**
+     * Switch profile and persist it
+     */
+    void setProfile(PowerProfile profile);
+
+    /**
+     * Currently applied profile
+     */
+    PowerProfile getProfile() const { return _profile; }
+
+    /**
+     * Human-readable profile name
+     */
+    static const char* profileName(PowerProfile profile);
+
+    /**
+     * Smoothed and worst wake latency in microseconds (timer alarm to loop())
+     */
+    uint32_t getWakeLatencyUs() const { return _wakeLatencyUs; }
+    uint32_t getMaxWakeLatencyUs() const { return _maxWakeLatencyUs; }
+
+    /**
+     * Smoothed status-query latency in microseconds (echo request to reply)
+     * @return 0 until a query was answered under that profile
+     */
+    uint32_t getQueryLatencyUs(PowerProfile profile) const;
+
+    /**
+     * WiFi power save mode read back from the driver
+     * @return WIFI_PS_UNKNOWN until the station has started
+     */
+    uint8_t getWiFiPowerSave() const { return _wifiPsActive; }
+
+    /**
+     * Human-readable WiFi power save mode
+     */
+    static const char* powerSaveName(uint8_t ps);
+
+    static constexpr uint8_t WIFI_PS_UNKNOWN = 0xFF;
+
+    /**
+     * Nominal average current draw for the active profile in mA
+     *
+     * Datasheet figures, not a measurement: the low-power figure assumes
+     * light sleep is entered, which the BLE controller's PM lock can still
+     * prevent even though esp_pm_configure() accepted the profile.
+     */
+    uint16_t getNominalCurrentMa() const;
+
+    // BLEServiceProvider
+    void setupService(NimBLEServer* pServer) override;
+
+    // NimBLECharacteristicCallbacks (NimBLE 1.4.x signatures)
+    void onWrite(NimBLECharacteristic* pCharacteristic) override;
+    void onRead(NimBLECharacteristic* pCharacteristic) override;
+
+private:
+    BLEProvisioning& _provisioning;
+    Preferences _preferences;
+
+    // BLE objects
+    NimBLECharacteristic* _pProfileChar;
+    NimBLECharacteristic* _pStatsChar;
+    NimBLECharacteristic* _pEchoChar;
+
+    PowerProfile _profile;
+    volatile uint8_t _requestedProfile;
+    uint32_t _loopPeriodMs;
+    bool _lightSleepConfigured;
+
+    // WiFi power save (requested, and as read back from the driver)
+    volatile wifi_ps_type_t _wifiPs;
+    volatile uint8_t _wifiPsActive;
+
+    // Wake latency
+    uint32_t _wakeLatencyUs;
+    uint32_t _maxWakeLatencyUs;
+    esp_timer_handle_t _probeTimer;
+    bool _probeArmed;
+    bool _probeValid;            // Loop was idle when the probe fired
+    int64_t _probeDueUs;
+    unsigned long _nextProbe;
+
+    // Status-query latency (echo written from the NimBLE task, answered in poll)
+    portMUX_TYPE _echoMux;
+    bool _echoPending;              // Guarded by _echoMux
+    int64_t _echoRequestUs;         // Guarded by _echoMux
+    uint8_t _echoToken[POWER_ECHO_MAX_LENGTH];
+    size_t _echoLength;
+    uint32_t _queryLatencyUs[POWER_PROFILE_COUNT];
+
+    static TaskHandle_t s_loopTask;
+    static portMUX_TYPE s_probeMux;
+    static int64_t s_probeFiredUs;  // Guarded by s_probeMux
+
+    static void onProbeTimer(void* arg);
+    void armProbe();
+    void checkProbe();
+    void applyProfile(PowerProfile profile);
+    void applyWiFi(PowerProfile profile);
+    void readBackWiFi();
+    void answerEcho();
+    void applyCpu(PowerProfile profile);
+    void resetLatencyStats();
+};
+
+#endif // POWER_MANAGER_H
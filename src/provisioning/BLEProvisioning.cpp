@@ -1,5 +1,7 @@
 #include "BLEProvisioning.h"
 #include "../config.h"
+#include "../power/PowerManager.h"
+#include <esp_wifi.h>
 
 BLEProvisioning::BLEProvisioning(CredentialStore& credentialStore)
     : _credentialStore(credentialStore)
@@ -9,11 +11,16 @@ BLEProvisioning::BLEProvisioning(CredentialStore& credentialStore)
     , _pPasswordChar(nullptr)
     , _pCommandChar(nullptr)
     , _pStatusChar(nullptr)
+    , _serviceProviders{}
+    , _serviceProviderCount(0)
     , _state(ProvisioningState::IDLE)
     , _bleClientConnected(false)
     , _bleInitialized(false)
     , _wifiConnectStartTime(0)
     , _wifiConnecting(false)
+    , _roaming(false)
+    , _roamStartTime(0)
+    , _roamBssid{}
     , _needsAdvertisingRestart(false)
     , _disconnectTime(0) {
 }
@@ -29,6 +36,36 @@ void BLEProvisioning::begin(const char* deviceName) {
     }
 }
 
+bool BLEProvisioning::addServiceProvider(BLEServiceProvider* provider) {
+    if (_bleInitialized || _serviceProviderCount >= MAX_SERVICE_PROVIDERS) {
+        Serial.println("[BLE] Cannot register service provider");
+        return false;
+    }
+
+    _serviceProviders[_serviceProviderCount++] = provider;
+    return true;
+}
+
+void BLEProvisioning::setRadioProfile(esp_power_level_t txPower, uint16_t advMinMs, uint16_t advMaxMs) {
+    if (!_bleInitialized) {
+        return;
+    }
+
+    NimBLEDevice::setPower(txPower);
+
+    // Interval is in 0.625 ms units
+    NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
+    pAdvertising->setMinInterval((advMinMs * 8) / 5);
+    pAdvertising->setMaxInterval((advMaxMs * 8) / 5);
+
+    // New interval only takes effect when advertising restarts
+    if (!_bleClientConnected && pAdvertising->isAdvertising()) {
+        startAdvertising();
+    }
+
+    Serial.printf("[BLE] TX power level %d, advertising every %u-%u ms\n", txPower, advMinMs, advMaxMs);
+}
+
 void BLEProvisioning::stop() {
     if (_bleInitialized) {
         NimBLEDevice::deinit(true);
@@ -91,6 +128,11 @@ void BLEProvisioning::setupBLE(const char* deviceName) {
     // Start the service FIRST
     _pService->start();
 
+    // Let other modules add their services before advertising begins
+    for (uint8_t i = 0; i < _serviceProviderCount; i++) {
+        _serviceProviders[i]->setupService(_pServer);
+    }
+
     // Configure advertising
     NimBLEAdvertising* pAdvertising = NimBLEDevice::getAdvertising();
     pAdvertising->addServiceUUID(SERVICE_UUID_WIFI_PROV);
@@ -142,6 +184,31 @@ void BLEProvisioning::poll() {
         }
     }
 
+    // Handle roam in progress (state stays CONNECTED)
+    if (_roaming) {
+        // Status may still report the old association right after WiFi.begin()
+        uint8_t* bssid = WiFi.BSSID();
+        if (WiFi.status() == WL_CONNECTED && bssid && memcmp(bssid, _roamBssid, 6) == 0) {
+            _roaming = false;
+            clearRoamPin();
+            Serial.printf("[WiFi] Roamed to %s (RSSI: %d dBm)\n", WiFi.BSSIDstr().c_str(), WiFi.RSSI());
+        }
+        else if (millis() - _roamStartTime > LINK_ROAM_TIMEOUT_MS) {
+            _roaming = false;
+            Serial.println("[WiFi] Roam timed out, reconnecting to any AP");
+
+            // Stored credentials only - nothing is saved on this path
+            String ssid, password;
+            if (_credentialStore.loadCredentials(ssid, password)) {
+                startConnection(ssid, password);
+            } else {
+                WiFi.disconnect();
+                updateState(ProvisioningState::DISCONNECTED);
+            }
+        }
+        return;
+    }
+
     // Check if WiFi was disconnected externally
     if (_state == ProvisioningState::CONNECTED && WiFi.status() != WL_CONNECTED) {
         Serial.println("[WiFi] Connection lost");
@@ -164,6 +231,29 @@ void BLEProvisioning::autoConnect() {
     }
 }
 
+bool BLEProvisioning::roamTo(const uint8_t* bssid, int32_t channel) {
+    if (_state != ProvisioningState::CONNECTED || _roaming) {
+        return false;
+    }
+
+    // Use stored credentials - pending ones may hold an unsent BLE edit
+    String ssid, password;
+    if (!_credentialStore.loadCredentials(ssid, password)) {
+        return false;
+    }
+
+    Serial.printf("[WiFi] Roaming to %02X:%02X:%02X:%02X:%02X:%02X on channel %d\n",
+                  bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5], channel);
+
+    // Pinning channel and BSSID skips the full scan inside WiFi.begin()
+    WiFi.begin(ssid.c_str(), password.c_str(), channel, bssid);
+
+    memcpy(_roamBssid, bssid, sizeof(_roamBssid));
+    _roamStartTime = millis();
+    _roaming = true;
+    return true;
+}
+
 void BLEProvisioning::connectToWiFi() {
     if (_pendingSsid.length() == 0) {
         Serial.println("[WiFi] No SSID to connect to");
@@ -177,6 +267,10 @@ void BLEProvisioning::connectToWiFi() {
         _credentialStore.saveCredentials(_pendingSsid, _pendingPassword);
     }
 
+    startConnection(_pendingSsid, _pendingPassword);
+}
+
+void BLEProvisioning::startConnection(const String& ssid, const String& password) {
     // Disconnect if already connected
     if (WiFi.status() == WL_CONNECTED) {
         WiFi.disconnect();
@@ -184,20 +278,35 @@ void BLEProvisioning::connectToWiFi() {
     }
 
     // Start connection
-    Serial.printf("[WiFi] Connecting to: %s\n", _pendingSsid.c_str());
+    Serial.printf("[WiFi] Connecting to: %s\n", ssid.c_str());
     updateState(ProvisioningState::CONNECTING);
 
     WiFi.mode(WIFI_STA);
-    WiFi.begin(_pendingSsid.c_str(), _pendingPassword.c_str());
+    WiFi.begin(ssid.c_str(), password.c_str());
 
     _wifiConnectStartTime = millis();
     _wifiConnecting = true;
 }
 
+void BLEProvisioning::clearRoamPin() {
+    // WiFi.begin() with a BSSID leaves it pinned in the station config, and
+    // the core's auto-reconnect would only ever rejoin that one AP
+    wifi_config_t config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &config) != ESP_OK) {
+        return;
+    }
+    config.sta.bssid_set = 0;
+    config.sta.channel = 0;
+    if (esp_wifi_set_config(WIFI_IF_STA, &config) != ESP_OK) {
+        Serial.println("[WiFi] Failed to clear roam BSSID");
+    }
+}
+
 void BLEProvisioning::disconnectWiFi() {
     Serial.println("[WiFi] Disconnecting");
     WiFi.disconnect();
     _wifiConnecting = false;
+    _roaming = false;
     updateState(ProvisioningState::DISCONNECTED);
 }
 
@@ -285,6 +394,7 @@ void BLEProvisioning::onConnect(NimBLEServer* pServer) {
     _bleClientConnected = true;
     Serial.println("[BLE] Client connected");
     Serial.printf("[BLE] Connected clients: %d\n", pServer->getConnectedCount());
+    PowerManager::wake();
 }
 
 void BLEProvisioning::onDisconnect(NimBLEServer* pServer) {
@@ -295,6 +405,7 @@ void BLEProvisioning::onDisconnect(NimBLEServer* pServer) {
     // (avoid calling BLE functions from callback context)
     _needsAdvertisingRestart = true;
     _disconnectTime = millis();
+    PowerManager::wake();
 }
 
 void BLEProvisioning::onWrite(NimBLECharacteristic* pCharacteristic) {
@@ -314,6 +425,9 @@ void BLEProvisioning::onWrite(NimBLECharacteristic* pCharacteristic) {
             handleCommand(value[0]);
         }
     }
+
+    // State changes are picked up by poll() in the main loop
+    PowerManager::wake();
 }
 
 void BLEProvisioning::onRead(NimBLECharacteristic* pCharacteristic) {
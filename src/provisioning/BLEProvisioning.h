@@ -18,6 +18,23 @@ enum class ProvisioningState : uint8_t {
     NO_CREDENTIALS = 0x05   // No SSID/password stored
 };
 
+/**
+ * BLEServiceProvider - Adds an extra GATT service to the provisioning server
+ *
+ * Providers are registered before begin() so their services exist before the
+ * GATT server starts advertising.
+ */
+class BLEServiceProvider {
+public:
+    virtual ~BLEServiceProvider() = default;
+
+    /**
+     * Create the provider's service and characteristics on the server
+     * @param pServer GATT server owned by BLEProvisioning
+     */
+    virtual void setupService(NimBLEServer* pServer) = 0;
+};
+
 /**
  * BLEProvisioning - BLE-based WiFi provisioning service
  *
@@ -39,6 +56,21 @@ public:
      */
     void begin(const char* deviceName = "AutoPrintFarm Hub");
 
+    /**
+     * Register an additional GATT service (must be called before begin)
+     * @param provider Service provider, must outlive this object
+     * @return false if too many providers are registered
+     */
+    bool addServiceProvider(BLEServiceProvider* provider);
+
+    /**
+     * Change TX power and advertising interval (restarts advertising if active)
+     * @param txPower NimBLE power level (e.g. ESP_PWR_LVL_P9)
+     * @param advMinMs Shortest advertising interval in milliseconds
+     * @param advMaxMs Longest advertising interval in milliseconds
+     */
+    void setRadioProfile(esp_power_level_t txPower, uint16_t advMinMs, uint16_t advMaxMs);
+
     /**
      * Stop BLE advertising and deinit
      */
@@ -80,6 +112,21 @@ public:
      */
     void autoConnect();
 
+    /**
+     * Reassociate with a specific AP of the current SSID
+     * State stays CONNECTED while roaming; falls back to a normal
+     * reconnect if the target AP does not accept us in time.
+     * @param bssid Target access point
+     * @param channel Channel of the target AP
+     * @return false if not connected or no credentials
+     */
+    bool roamTo(const uint8_t* bssid, int32_t channel);
+
+    /**
+     * Check if a roam is in progress
+     */
+    bool isRoaming() const { return _roaming; }
+
     // NimBLEServerCallbacks (NimBLE 1.4.x signatures)
     void onConnect(NimBLEServer* pServer) override;
     void onDisconnect(NimBLEServer* pServer) override;
@@ -99,6 +146,11 @@ private:
     NimBLECharacteristic* _pCommandChar;
     NimBLECharacteristic* _pStatusChar;
 
+    // Additional services registered by other modules
+    static constexpr uint8_t MAX_SERVICE_PROVIDERS = 4;
+    BLEServiceProvider* _serviceProviders[MAX_SERVICE_PROVIDERS];
+    uint8_t _serviceProviderCount;
+
     // State
     ProvisioningState _state;
     bool _bleClientConnected;
@@ -112,6 +164,11 @@ private:
     unsigned long _wifiConnectStartTime;
     bool _wifiConnecting;
 
+    // Roaming between APs of the same SSID
+    bool _roaming;
+    unsigned long _roamStartTime;
+    uint8_t _roamBssid[6];
+
     // BLE reconnection handling
     bool _needsAdvertisingRestart;
     unsigned long _disconnectTime;
@@ -121,6 +178,8 @@ private:
     void startAdvertising();
     void handleCommand(uint8_t cmd);
     void connectToWiFi();
+    void startConnection(const String& ssid, const String& password);
+    void clearRoamPin();
     void disconnectWiFi();
     void updateState(ProvisioningState newState);
     void notifyStatus();
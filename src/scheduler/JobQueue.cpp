@@ -0,0 +1,535 @@
+#include "JobQueue.h"
+#include <string.h>
+
+namespace {
+
+const uint8_t SNAPSHOT_MAGIC[2] = { 'J', 'Q' };
+const uint8_t SNAPSHOT_VERSION = 1;
+const size_t SNAPSHOT_HEADER_SIZE = 13;   // magic, version, u16 count, u32 nextId, u32 nextSeq
+const size_t SNAPSHOT_RECORD_SIZE = 22;
+
+void putU16(uint8_t*& p, uint16_t v) {
+    *p++ = v & 0xFF;
+    *p++ = v >> 8;
+}
+
+void putU32(uint8_t*& p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        *p++ = (v >> (8 * i)) & 0xFF;
+    }
+}
+
+uint16_t getU16(const uint8_t*& p) {
+    uint16_t v = p[0] | (p[1] << 8);
+    p += 2;
+    return v;
+}
+
+uint32_t getU32(const uint8_t*& p) {
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    p += 4;
+    return v;
+}
+
+}  // namespace
+
+JobQueue::JobQueue(uint16_t maxJobs, uint8_t maxPrinters, uint8_t maxAttempts)
+    : _maxJobs(maxJobs)
+    , _maxPrinters(maxPrinters)
+    , _maxAttempts(maxAttempts)
+    , _nextId(1)
+    , _nextSeq(0)
+    , _queued(0)
+    , _running(0)
+    , _nextPrinter(0)
+    , _dirty(false) {
+    _jobs.resize(maxJobs);
+    _printers.reserve(maxPrinters);
+    memset(_nozzles, 0, sizeof(_nozzles));
+    clearJobs();
+}
+
+// =============================================================================
+// Jobs
+// =============================================================================
+
+uint32_t JobQueue::addJob(uint32_t fileId, uint8_t priority, Material material, uint8_t nozzle) {
+    if (static_cast<uint8_t>(material) >= MATERIAL_COUNT || nozzle == 0 ||
+        nozzleSlot(nozzle, true) < 0) {
+        return 0;
+    }
+
+    uint16_t slot = allocSlot();
+    if (slot == NO_JOB) {
+        return 0;
+    }
+
+    Job& job = _jobs[slot];
+    job.id = _nextId++;
+    job.fileId = fileId;
+    job.seq = _nextSeq++;
+    job.printerKey = 0;
+    job.priority = priority;
+    job.material = material;
+    job.nozzle = nozzle;
+    job.attempts = 0;
+    job.started = false;
+    job.dispatchedAt = 0;
+
+    enqueue(slot);
+    return job.id;
+}
+
+bool JobQueue::cancelJob(uint32_t jobId) {
+    uint16_t slot = findJob(jobId);
+    if (slot == NO_JOB || _jobs[slot].state != JobState::QUEUED) {
+        return false;
+    }
+
+    heapRemove(heapFor(_jobs[slot]), _jobs[slot].heapPos);
+    _queued--;
+    freeSlot(slot);
+    _dirty = true;
+    return true;
+}
+
+bool JobQueue::reportResult(uint32_t jobId, bool success) {
+    uint16_t slot = findJob(jobId);
+    if (slot == NO_JOB || _jobs[slot].state != JobState::RUNNING) {
+        return false;
+    }
+
+    finishRunning(slot, success);
+    return true;
+}
+
+uint16_t JobQueue::findJob(uint32_t jobId) const {
+    for (uint16_t i = 0; i < _maxJobs; i++) {
+        const Job& job = _jobs[i];
+        if (job.id == jobId && (job.state == JobState::QUEUED || job.state == JobState::RUNNING)) {
+            return i;
+        }
+    }
+    return NO_JOB;
+}
+
+void JobQueue::clearJobs() {
+    for (auto& row : _heaps) {
+        for (auto& heap : row) {
+            heap.clear();
+        }
+    }
+
+    _freeSlots.clear();
+    for (uint16_t i = _maxJobs; i > 0; i--) {
+        _jobs[i - 1] = Job{};
+        _jobs[i - 1].state = JobState::DONE;
+        _jobs[i - 1].heapPos = -1;
+        _freeSlots.push_back(i - 1);
+    }
+
+    for (auto& printer : _printers) {
+        printer.job = -1;
+    }
+
+    _queued = 0;
+    _running = 0;
+}
+
+uint16_t JobQueue::allocSlot() {
+    if (_freeSlots.empty()) {
+        return NO_JOB;
+    }
+    uint16_t slot = _freeSlots.back();
+    _freeSlots.pop_back();
+    return slot;
+}
+
+void JobQueue::freeSlot(uint16_t slot) {
+    // A free slot must never look live to findJob() or serialize()
+    if (_jobs[slot].state == JobState::QUEUED || _jobs[slot].state == JobState::RUNNING) {
+        _jobs[slot].state = JobState::DONE;
+    }
+    _jobs[slot].heapPos = -1;
+    _freeSlots.push_back(slot);
+}
+
+void JobQueue::enqueue(uint16_t slot) {
+    Job& job = _jobs[slot];
+    job.state = JobState::QUEUED;
+    job.printerKey = 0;
+    job.started = false;
+    heapPush(heapFor(job), slot);
+    _queued++;
+    _dirty = true;
+}
+
+void JobQueue::finishRunning(uint16_t slot, bool success) {
+    Job& job = _jobs[slot];
+
+    Printer* printer = findPrinter(job.printerKey);
+    if (printer && printer->job == static_cast<int16_t>(slot)) {
+        printer->job = -1;
+    }
+    _running--;
+    _dirty = true;
+
+    if (!success && job.attempts < _maxAttempts) {
+        enqueue(slot);
+        return;
+    }
+
+    job.state = success ? JobState::DONE : JobState::FAILED;
+    if (_onFinished) {
+        _onFinished(job);
+    }
+    freeSlot(slot);
+}
+
+// =============================================================================
+// Printers and Dispatch
+// =============================================================================
+
+bool JobQueue::updatePrinter(uint32_t key, PrinterStatus status, uint16_t materials, uint8_t nozzle) {
+    Printer* printer = findPrinter(key);
+    if (!printer) {
+        if (_printers.size() >= _maxPrinters) {
+            return false;
+        }
+        _printers.push_back(Printer{ key, 0, 0, PrinterStatus::OFFLINE, -1 });
+        printer = &_printers.back();
+    }
+
+    printer->materials = materials;
+    printer->nozzle = nozzle;
+    printer->status = status;
+
+    if (printer->job < 0) {
+        return true;
+    }
+
+    uint16_t slot = static_cast<uint16_t>(printer->job);
+    switch (status) {
+        case PrinterStatus::PRINTING:
+            _jobs[slot].started = true;
+            break;
+        case PrinterStatus::IDLE:
+            // Idle before it ever started means the dispatch is still pending
+            if (_jobs[slot].started) {
+                finishRunning(slot, true);
+            }
+            break;
+        case PrinterStatus::ERROR:
+        case PrinterStatus::OFFLINE:
+            finishRunning(slot, false);
+            break;
+    }
+
+    return true;
+}
+
+uint16_t JobQueue::dispatchNext(uint32_t nowMs, uint32_t& printerKey) {
+    if (_queued == 0) {
+        return NO_JOB;
+    }
+
+    size_t count = _printers.size();
+    for (size_t n = 0; n < count; n++) {
+        size_t index = (_nextPrinter + n) % count;
+        Printer& printer = _printers[index];
+        if (printer.status != PrinterStatus::IDLE || printer.job >= 0) {
+            continue;
+        }
+
+        int nozzle = nozzleSlot(printer.nozzle, false);
+        if (nozzle < 0) {
+            continue;
+        }
+
+        // Best head among the classes this printer can print
+        std::vector<uint16_t>* best = nullptr;
+        for (uint8_t m = 0; m < MATERIAL_COUNT; m++) {
+            if (!(printer.materials & (1u << m))) {
+                continue;
+            }
+            std::vector<uint16_t>& heap = _heaps[m][nozzle];
+            if (!heap.empty() && (!best || before(heap[0], (*best)[0]))) {
+                best = &heap;
+            }
+        }
+        if (!best) {
+            continue;
+        }
+
+        uint16_t slot = (*best)[0];
+        heapRemove(*best, 0);
+        _queued--;
+        _running++;
+
+        Job& job = _jobs[slot];
+        job.state = JobState::RUNNING;
+        job.printerKey = printer.key;
+        job.attempts++;
+        job.started = false;
+        job.dispatchedAt = nowMs;
+        printer.job = static_cast<int16_t>(slot);
+
+        _nextPrinter = static_cast<uint8_t>((index + 1) % count);
+        _dirty = true;
+        printerKey = printer.key;
+        return slot;
+    }
+
+    return NO_JOB;
+}
+
+void JobQueue::rejectDispatch(uint16_t slot) {
+    if (slot >= _maxJobs || _jobs[slot].state != JobState::RUNNING) {
+        return;
+    }
+
+    // Take the printer out of rotation until it reports in again
+    Printer* printer = findPrinter(_jobs[slot].printerKey);
+    if (printer) {
+        printer->status = PrinterStatus::OFFLINE;
+    }
+    finishRunning(slot, false);
+}
+
+uint16_t JobQueue::expireDispatches(uint32_t nowMs, uint32_t timeoutMs) {
+    uint16_t expired = 0;
+    for (auto& printer : _printers) {
+        if (printer.job < 0) {
+            continue;
+        }
+        uint16_t slot = static_cast<uint16_t>(printer.job);
+        Job& job = _jobs[slot];
+        if (!job.started && nowMs - job.dispatchedAt > timeoutMs) {
+            finishRunning(slot, false);
+            expired++;
+        }
+    }
+    return expired;
+}
+
+uint8_t JobQueue::getIdlePrinterCount() const {
+    uint8_t idle = 0;
+    for (const auto& printer : _printers) {
+        if (printer.status == PrinterStatus::IDLE && printer.job < 0) {
+            idle++;
+        }
+    }
+    return idle;
+}
+
+Printer* JobQueue::findPrinter(uint32_t key) {
+    for (auto& printer : _printers) {
+        if (printer.key == key) {
+            return &printer;
+        }
+    }
+    return nullptr;
+}
+
+int JobQueue::nozzleSlot(uint8_t nozzle, bool create) {
+    int freeSlot = -1;
+    for (uint8_t i = 0; i < NOZZLE_SLOTS; i++) {
+        if (_nozzles[i] == nozzle) {
+            return i;
+        }
+        if (_nozzles[i] == 0 && freeSlot < 0) {
+            freeSlot = i;
+        }
+    }
+
+    if (!create || freeSlot < 0 || nozzle == 0) {
+        return -1;
+    }
+    _nozzles[freeSlot] = nozzle;
+    return freeSlot;
+}
+
+// =============================================================================
+// Class Heaps
+// =============================================================================
+
+std::vector<uint16_t>& JobQueue::heapFor(const Job& job) {
+    return _heaps[static_cast<uint8_t>(job.material)][nozzleSlot(job.nozzle, true)];
+}
+
+bool JobQueue::before(uint16_t a, uint16_t b) const {
+    const Job& ja = _jobs[a];
+    const Job& jb = _jobs[b];
+    if (ja.priority != jb.priority) {
+        return ja.priority > jb.priority;
+    }
+    return ja.seq < jb.seq;
+}
+
+void JobQueue::place(std::vector<uint16_t>& heap, int16_t pos, uint16_t slot) {
+    heap[pos] = slot;
+    _jobs[slot].heapPos = pos;
+}
+
+void JobQueue::heapPush(std::vector<uint16_t>& heap, uint16_t slot) {
+    heap.push_back(slot);
+    _jobs[slot].heapPos = static_cast<int16_t>(heap.size() - 1);
+    siftUp(heap, _jobs[slot].heapPos);
+}
+
+void JobQueue::heapRemove(std::vector<uint16_t>& heap, int16_t pos) {
+    uint16_t removed = heap[pos];
+    uint16_t last = heap.back();
+    heap.pop_back();
+    _jobs[removed].heapPos = -1;
+
+    if (pos < static_cast<int16_t>(heap.size())) {
+        place(heap, pos, last);
+        siftUp(heap, pos);
+        siftDown(heap, _jobs[last].heapPos);
+    }
+}
+
+void JobQueue::siftUp(std::vector<uint16_t>& heap, int16_t pos) {
+    uint16_t slot = heap[pos];
+    while (pos > 0) {
+        int16_t parent = (pos - 1) / 2;
+        if (!before(slot, heap[parent])) {
+            break;
+        }
+        place(heap, pos, heap[parent]);
+        pos = parent;
+    }
+    place(heap, pos, slot);
+}
+
+void JobQueue::siftDown(std::vector<uint16_t>& heap, int16_t pos) {
+    int16_t size = static_cast<int16_t>(heap.size());
+    uint16_t slot = heap[pos];
+    for (;;) {
+        int16_t child = 2 * pos + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!before(heap[child], slot)) {
+            break;
+        }
+        place(heap, pos, heap[child]);
+        pos = child;
+    }
+    place(heap, pos, slot);
+}
+
+// =============================================================================
+// Snapshot
+// =============================================================================
+
+size_t JobQueue::maxSnapshotSize() const {
+    return SNAPSHOT_HEADER_SIZE + SNAPSHOT_RECORD_SIZE * _maxJobs;
+}
+
+size_t JobQueue::serialize(uint8_t* buffer, size_t capacity) const {
+    uint16_t count = _queued + _running;
+    size_t size = SNAPSHOT_HEADER_SIZE + SNAPSHOT_RECORD_SIZE * count;
+    if (size > capacity) {
+        return 0;
+    }
+
+    uint8_t* p = buffer;
+    *p++ = SNAPSHOT_MAGIC[0];
+    *p++ = SNAPSHOT_MAGIC[1];
+    *p++ = SNAPSHOT_VERSION;
+    putU16(p, count);
+    putU32(p, _nextId);
+    putU32(p, _nextSeq);
+
+    for (const auto& job : _jobs) {
+        if (job.state != JobState::QUEUED && job.state != JobState::RUNNING) {
+            continue;
+        }
+        putU32(p, job.id);
+        putU32(p, job.fileId);
+        putU32(p, job.seq);
+        putU32(p, job.printerKey);
+        *p++ = job.priority;
+        *p++ = static_cast<uint8_t>(job.material);
+        *p++ = job.nozzle;
+        *p++ = static_cast<uint8_t>(job.state);
+        *p++ = job.attempts;
+        *p++ = job.started ? 1 : 0;
+    }
+
+    return size;
+}
+
+bool JobQueue::deserialize(const uint8_t* buffer, size_t length) {
+    if (length < SNAPSHOT_HEADER_SIZE ||
+        buffer[0] != SNAPSHOT_MAGIC[0] || buffer[1] != SNAPSHOT_MAGIC[1] ||
+        buffer[2] != SNAPSHOT_VERSION) {
+        return false;
+    }
+
+    const uint8_t* p = buffer + 3;
+    uint16_t count = getU16(p);
+    if (count > _maxJobs || length < SNAPSHOT_HEADER_SIZE + SNAPSHOT_RECORD_SIZE * count) {
+        return false;
+    }
+
+    clearJobs();
+    _nextId = getU32(p);
+    _nextSeq = getU32(p);
+
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t slot = allocSlot();
+        Job& job = _jobs[slot];
+        job.id = getU32(p);
+        job.fileId = getU32(p);
+        job.seq = getU32(p);
+        job.printerKey = getU32(p);
+        job.priority = *p++;
+        job.material = static_cast<Material>(*p++ & (MATERIAL_COUNT - 1));
+        job.nozzle = *p++;
+        JobState state = static_cast<JobState>(*p++);
+        job.attempts = *p++;
+        job.started = *p++ != 0;
+        job.dispatchedAt = 0;
+
+        if (job.nozzle == 0 || nozzleSlot(job.nozzle, true) < 0) {
+            job.state = JobState::FAILED;
+            freeSlot(slot);
+            continue;
+        }
+
+        // A dispatch that never started may not have reached the printer
+        if (state != JobState::RUNNING || !job.started) {
+            enqueue(slot);
+            continue;
+        }
+
+        // Keep the assignment; the printer's next status report resolves it
+        Printer* printer = findPrinter(job.printerKey);
+        if (!printer) {
+            if (_printers.size() >= _maxPrinters) {
+                enqueue(slot);
+                continue;
+            }
+            _printers.push_back(Printer{ job.printerKey, 0, 0, PrinterStatus::OFFLINE, -1 });
+            printer = &_printers.back();
+        }
+        // A printer runs one job; a second claim on it goes back in the queue
+        if (printer->job >= 0) {
+            enqueue(slot);
+            continue;
+        }
+        job.state = JobState::RUNNING;
+        job.heapPos = -1;
+        printer->job = static_cast<int16_t>(slot);
+        _running++;
+    }
+
+    _dirty = false;
+    return true;
+}
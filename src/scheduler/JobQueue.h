@@ -0,0 +1,228 @@
+#ifndef JOB_QUEUE_H
+#define JOB_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+/**
+ * Filament materials (bit index in a printer's material mask)
+ */
+enum class Material : uint8_t {
+    PLA   = 0,
+    PETG  = 1,
+    ABS   = 2,
+    ASA   = 3,
+    TPU   = 4,
+    PA    = 5,
+    PC    = 6,
+    OTHER = 7
+};
+
+/**
+ * Live printer status
+ */
+enum class PrinterStatus : uint8_t {
+    OFFLINE  = 0x00,  // Not reachable
+    IDLE     = 0x01,  // Ready for a job
+    PRINTING = 0x02,  // Busy with a job
+    ERROR    = 0x03   // Needs attention
+};
+
+/**
+ * Job lifecycle
+ */
+enum class JobState : uint8_t {
+    QUEUED   = 0x00,
+    RUNNING  = 0x01,  // Dispatched to a printer
+    DONE     = 0x02,
+    FAILED   = 0x03   // Gave up after too many attempts
+};
+
+/**
+ * A print job
+ */
+struct Job {
+    uint32_t id;
+    uint32_t fileId;        // Sliced file reference on the farm server
+    uint32_t seq;           // Submission order (FIFO among equal priority)
+    uint32_t printerKey;    // Key of the assigned printer (RUNNING only)
+    uint8_t priority;       // Higher runs first
+    Material material;
+    uint8_t nozzle;         // Nozzle diameter in 1/100 mm (40 = 0.4 mm)
+    JobState state;
+    uint8_t attempts;
+    bool started;           // Printer was seen printing this job
+    uint32_t dispatchedAt;  // Time of dispatch in ms (not persisted)
+    int16_t heapPos;        // Position in its class heap (-1 if not queued)
+};
+
+/**
+ * A printer the scheduler can dispatch to
+ */
+struct Printer {
+    uint32_t key;           // Stable key (hash of printer name)
+    uint16_t materials;     // Bit mask of loaded Material values
+    uint8_t nozzle;         // Nozzle diameter in 1/100 mm
+    PrinterStatus status;
+    int16_t job;            // Slot of the running job (-1 if none)
+};
+
+/**
+ * JobQueue - Constraint-aware priority queue of print jobs
+ *
+ * Queued jobs are kept in one binary heap per (material, nozzle) class, so
+ * an idle printer only peeks the heads of the few classes it can print.
+ * Picking the next job is O(classes + log n) regardless of queue length.
+ *
+ * Pure logic with fixed capacity and no Arduino dependencies: persistence
+ * and transport live in JobScheduler, and the queue can be driven on the
+ * host with emulated printers.
+ */
+class JobQueue {
+public:
+    static constexpr uint16_t NO_JOB = 0xFFFF;
+
+    /**
+     * @param maxJobs Job pool capacity (queued + running)
+     * @param maxPrinters Printer table capacity
+     * @param maxAttempts Dispatches before a job is marked FAILED
+     */
+    JobQueue(uint16_t maxJobs, uint8_t maxPrinters, uint8_t maxAttempts);
+
+    /**
+     * Add a job
+     * @return job id, or 0 if the queue is full or the job is invalid
+     */
+    uint32_t addJob(uint32_t fileId, uint8_t priority, Material material, uint8_t nozzle);
+
+    /**
+     * Remove a queued job (running jobs cannot be cancelled here)
+     */
+    bool cancelJob(uint32_t jobId);
+
+    /**
+     * Report the outcome of a running job
+     * Failed jobs are requeued until maxAttempts is reached
+     */
+    bool reportResult(uint32_t jobId, bool success);
+
+    /**
+     * Add or update a printer with its live status and capabilities
+     * Transitions resolve the printer's running job:
+     *   PRINTING -> IDLE      job done
+     *   -> ERROR / OFFLINE    job requeued
+     * @return false if the printer table is full
+     */
+    bool updatePrinter(uint32_t key, PrinterStatus status, uint16_t materials, uint8_t nozzle);
+
+    /**
+     * Pick the next (printer, job) pair and mark the job RUNNING
+     * Idle printers are served round-robin.
+     * @param nowMs Current time, recorded as dispatch time
+     * @param printerKey Output: printer to send the job to
+     * @return job slot, or NO_JOB if nothing can be dispatched
+     */
+    uint16_t dispatchNext(uint32_t nowMs, uint32_t& printerKey);
+
+    /**
+     * Undo a dispatch the printer did not accept (counts as an attempt)
+     * The printer is marked OFFLINE until its next status update.
+     */
+    void rejectDispatch(uint16_t slot);
+
+    /**
+     * Requeue dispatched jobs whose printer never started printing
+     * @return number of jobs requeued
+     */
+    uint16_t expireDispatches(uint32_t nowMs, uint32_t timeoutMs);
+
+    /**
+     * Called whenever a job leaves the queue for good (DONE or FAILED)
+     */
+    void setFinishedCallback(std::function<void(const Job&)> callback) { _onFinished = callback; }
+
+    /**
+     * Access a job by slot
+     */
+    const Job& getJob(uint16_t slot) const { return _jobs[slot]; }
+
+    /**
+     * Find a job slot by id (NO_JOB if unknown)
+     */
+    uint16_t findJob(uint32_t jobId) const;
+
+    uint16_t getQueuedCount() const { return _queued; }
+    uint16_t getRunningCount() const { return _running; }
+    uint8_t getPrinterCount() const { return static_cast<uint8_t>(_printers.size()); }
+    uint8_t getIdlePrinterCount() const;
+
+    /**
+     * Changes since the last clearDirty() (for snapshot scheduling)
+     */
+    bool isDirty() const { return _dirty; }
+    void clearDirty() { _dirty = false; }
+
+    /**
+     * Compact snapshot of queued and running jobs
+     * @return bytes written, or 0 if the buffer is too small
+     */
+    size_t serialize(uint8_t* buffer, size_t capacity) const;
+
+    /**
+     * Restore jobs from a snapshot (replaces current jobs)
+     * @return false if the snapshot is malformed
+     */
+    bool deserialize(const uint8_t* buffer, size_t length);
+
+    /**
+     * Upper bound of a snapshot at full capacity
+     */
+    size_t maxSnapshotSize() const;
+
+private:
+    static constexpr uint8_t MATERIAL_COUNT = 8;
+    static constexpr uint8_t NOZZLE_SLOTS = 8;
+
+    uint16_t _maxJobs;
+    uint8_t _maxPrinters;
+    uint8_t _maxAttempts;
+
+    std::vector<Job> _jobs;
+    std::vector<uint16_t> _freeSlots;
+    std::vector<Printer> _printers;
+
+    // Heaps of job slots, indexed [material][nozzle slot]
+    std::vector<uint16_t> _heaps[MATERIAL_COUNT][NOZZLE_SLOTS];
+    uint8_t _nozzles[NOZZLE_SLOTS];   // Diameter for each nozzle slot (0 = unused)
+
+    uint32_t _nextId;
+    uint32_t _nextSeq;
+    uint16_t _queued;
+    uint16_t _running;
+    uint8_t _nextPrinter;    // Round-robin start for dispatch
+    bool _dirty;
+
+    std::function<void(const Job&)> _onFinished;
+
+    int nozzleSlot(uint8_t nozzle, bool create);
+    Printer* findPrinter(uint32_t key);
+    uint16_t allocSlot();
+    void freeSlot(uint16_t slot);
+
+    void clearJobs();
+    void enqueue(uint16_t slot);
+    void finishRunning(uint16_t slot, bool success);
+
+    // Class heap operations
+    std::vector<uint16_t>& heapFor(const Job& job);
+    bool before(uint16_t a, uint16_t b) const;
+    void heapPush(std::vector<uint16_t>& heap, uint16_t slot);
+    void heapRemove(std::vector<uint16_t>& heap, int16_t pos);
+    void siftUp(std::vector<uint16_t>& heap, int16_t pos);
+    void siftDown(std::vector<uint16_t>& heap, int16_t pos);
+    void place(std::vector<uint16_t>& heap, int16_t pos, uint16_t slot);
+};
+
+#endif // JOB_QUEUE_H
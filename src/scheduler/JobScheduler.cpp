@@ -0,0 +1,332 @@
+#include "JobScheduler.h"
+#include "../config.h"
+#include "../power/PowerManager.h"
+
+namespace {
+
+// NVS geometry: 32-byte entries, 126 to a 4 KB page, one page held back for GC
+const size_t NVS_ENTRY_SIZE = 32;
+const size_t NVS_ENTRIES_PER_PAGE = 126;
+const size_t NVS_CHUNK_DATA = (NVS_ENTRIES_PER_PAGE - 1) * NVS_ENTRY_SIZE;
+
+/**
+ * Entries a blob of this length occupies: its data, one header per chunk
+ * (a chunk never spans pages) and the blob index.
+ */
+size_t blobEntries(size_t length) {
+    size_t chunks = (length + NVS_CHUNK_DATA - 1) / NVS_CHUNK_DATA;
+    return (length + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE + chunks + 1;
+}
+
+uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+}  // namespace
+
+JobScheduler::JobScheduler()
+    : _queue(SCHED_MAX_JOBS, SCHED_MAX_PRINTERS, SCHED_MAX_ATTEMPTS)
+    , _nvs(0)
+    , _commandQueue(nullptr)
+    , _pCommandChar(nullptr)
+    , _pEventsChar(nullptr)
+    , _snapshotBuffer(nullptr)
+    , _lastChange(0)
+    , _snapshotDelay(SCHED_SNAPSHOT_DELAY_MS)
+    , _lastDispatchUs(0)
+    , _maxDispatchUs(0) {
+}
+
+bool JobScheduler::begin() {
+    _commandQueue = xQueueCreate(SCHED_COMMAND_QUEUE_LENGTH, sizeof(Command));
+    _snapshotBuffer = static_cast<uint8_t*>(malloc(_queue.maxSnapshotSize()));
+    if (!_commandQueue || !_snapshotBuffer) {
+        Serial.println("[Jobs] Failed to allocate scheduler buffers");
+        return false;
+    }
+
+    _queue.setFinishedCallback([this](const Job& job) {
+        bool done = job.state == JobState::DONE;
+        Serial.printf("[Jobs] Job %u %s\n", job.id, done ? "done" : "failed, giving up");
+        notifyEvent(done ? JOB_EVENT_DONE : JOB_EVENT_FAILED, job.id, job.fileId, job.printerKey);
+    });
+
+    esp_err_t err = nvs_open(NVS_NAMESPACE_JOBS, NVS_READWRITE, &_nvs);
+    if (err != ESP_OK) {
+        Serial.printf("[Jobs] Failed to open NVS namespace: %s\n", esp_err_to_name(err));
+        return false;
+    }
+
+    size_t length = _queue.maxSnapshotSize();
+    err = nvs_get_blob(_nvs, NVS_KEY_SNAPSHOT, _snapshotBuffer, &length);
+    if (err == ESP_OK) {
+        if (_queue.deserialize(_snapshotBuffer, length)) {
+            Serial.printf("[Jobs] Restored %u queued, %u running jobs\n",
+                          _queue.getQueuedCount(), _queue.getRunningCount());
+        } else {
+            Serial.println("[Jobs] Snapshot invalid, starting with empty queue");
+        }
+    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+        Serial.printf("[Jobs] Snapshot unreadable (%s), starting with empty queue\n", esp_err_to_name(err));
+    }
+
+    return true;
+}
+
+void JobScheduler::poll(bool networkUp) {
+    if (!_commandQueue) {
+        return;
+    }
+
+    Command cmd;
+    while (xQueueReceive(_commandQueue, &cmd, 0) == pdTRUE) {
+        applyCommand(cmd);
+    }
+
+    _queue.expireDispatches(millis(), SCHED_DISPATCH_TIMEOUT_MS);
+
+    if (networkUp) {
+        dispatchReady();
+    }
+
+    // Debounced snapshot - a burst of changes costs one flash write
+    if (_queue.isDirty()) {
+        _queue.clearDirty();
+        _lastChange = millis();
+    }
+    if (_lastChange != 0 && millis() - _lastChange > _snapshotDelay) {
+        if (saveSnapshot()) {
+            _lastChange = 0;
+            _snapshotDelay = SCHED_SNAPSHOT_DELAY_MS;
+        } else {
+            // NVS is full; try again later rather than on every loop
+            _lastChange = millis();
+            _snapshotDelay = SCHED_SNAPSHOT_RETRY_MS;
+        }
+    }
+}
+
+uint32_t JobScheduler::printerKey(const char* name, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<uint8_t>(name[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// =============================================================================
+// Queue Operations
+// =============================================================================
+
+void JobScheduler::applyCommand(const Command& cmd) {
+    const uint8_t* d = cmd.data;
+
+    switch (d[0]) {
+        case JOB_CMD_ADD: {
+            if (cmd.length < 8) {
+                break;
+            }
+            uint32_t fileId = readU32(d + 1);
+            uint32_t id = _queue.addJob(fileId, d[5], static_cast<Material>(d[6]), d[7]);
+            if (id == 0) {
+                Serial.printf("[Jobs] Rejected job for file %u\n", fileId);
+                notifyEvent(JOB_EVENT_REJECTED, 0, fileId, 0);
+                return;
+            }
+            Serial.printf("[Jobs] Queued job %u (file %u, priority %u)\n", id, fileId, d[5]);
+            notifyEvent(JOB_EVENT_ADDED, id, fileId, 0);
+            return;
+        }
+
+        case JOB_CMD_CANCEL:
+            if (cmd.length < 5) {
+                break;
+            }
+            if (_queue.cancelJob(readU32(d + 1))) {
+                Serial.printf("[Jobs] Cancelled job %u\n", readU32(d + 1));
+                return;
+            }
+            notifyEvent(JOB_EVENT_REJECTED, readU32(d + 1), 0, 0);
+            return;
+
+        case JOB_CMD_RESULT:
+            if (cmd.length < 6) {
+                break;
+            }
+            if (!_queue.reportResult(readU32(d + 1), d[5] != 0)) {
+                notifyEvent(JOB_EVENT_REJECTED, readU32(d + 1), 0, 0);
+            }
+            return;
+
+        case JOB_CMD_PRINTER: {
+            if (cmd.length < 6) {
+                break;
+            }
+            if (d[1] > static_cast<uint8_t>(PrinterStatus::ERROR)) {
+                Serial.printf("[Jobs] Unknown printer status: %d\n", d[1]);
+                return;
+            }
+            uint32_t key = printerKey(reinterpret_cast<const char*>(d + 5), cmd.length - 5);
+            uint16_t materials = d[2] | (d[3] << 8);
+            if (!_queue.updatePrinter(key, static_cast<PrinterStatus>(d[1]), materials, d[4])) {
+                Serial.println("[Jobs] Printer table full");
+                notifyEvent(JOB_EVENT_REJECTED, 0, 0, key);
+            }
+            return;
+        }
+
+        default:
+            Serial.printf("[Jobs] Unknown command: 0x%02X\n", d[0]);
+            return;
+    }
+
+    Serial.printf("[Jobs] Command 0x%02X too short\n", d[0]);
+}
+
+void JobScheduler::dispatchReady() {
+    // Without a driver the events notification is the only way a job
+    // reaches a printer - dispatching with nobody listening would just
+    // burn attempts until the job fails
+    if (!_dispatchHandler && (!_pEventsChar || _pEventsChar->getSubscribedCount() == 0)) {
+        return;
+    }
+
+    for (;;) {
+        uint32_t key = 0;
+        unsigned long start = micros();
+        uint16_t slot = _queue.dispatchNext(millis(), key);
+        uint32_t elapsed = micros() - start;
+
+        if (slot == JobQueue::NO_JOB) {
+            return;
+        }
+
+        _lastDispatchUs = elapsed;
+        if (elapsed > _maxDispatchUs) {
+            _maxDispatchUs = elapsed;
+        }
+
+        const Job& job = _queue.getJob(slot);
+        Serial.printf("[Jobs] Dispatching job %u (file %u) to printer %08X in %u us\n",
+                      job.id, job.fileId, key, elapsed);
+        notifyEvent(JOB_EVENT_DISPATCHED, job.id, job.fileId, key);
+
+        if (_dispatchHandler && !_dispatchHandler(job, key)) {
+            Serial.printf("[Jobs] Printer %08X refused job %u\n", key, job.id);
+            _queue.rejectDispatch(slot);
+        }
+    }
+}
+
+bool JobScheduler::saveSnapshot() {
+    size_t length = _queue.serialize(_snapshotBuffer, _queue.maxSnapshotSize());
+    if (length == 0) {
+        Serial.println("[Jobs] Failed to serialize snapshot");
+        return false;
+    }
+
+    // NVS writes the new blob before releasing the old one, so a rewrite needs
+    // room for a second copy on top of the page held back for GC
+    nvs_stats_t stats = {};
+    size_t needed = blobEntries(length);
+    bool room = nvs_get_stats(nullptr, &stats) != ESP_OK ||
+                stats.free_entries >= needed + NVS_ENTRIES_PER_PAGE;
+
+    esp_err_t err = room ? writeSnapshot(length) : ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    if (err == ESP_ERR_NVS_NOT_ENOUGH_SPACE) {
+        // A stale snapshot would replay finished and cancelled jobs after a
+        // reboot; drop it, which also lets GC reclaim its entries
+        Serial.printf("[Jobs] NVS low (%u free entries, snapshot needs %u), replacing old snapshot\n",
+                      (unsigned)stats.free_entries, (unsigned)needed);
+        nvs_erase_key(_nvs, NVS_KEY_SNAPSHOT);
+        err = writeSnapshot(length);
+    }
+    if (err != ESP_OK) {
+        Serial.printf("[Jobs] Snapshot not saved (%s), queue will not survive a reboot\n", esp_err_to_name(err));
+        return false;
+    }
+
+    Serial.printf("[Jobs] Snapshot saved (%u bytes)\n", (unsigned)length);
+    return true;
+}
+
+esp_err_t JobScheduler::writeSnapshot(size_t length) {
+    esp_err_t err = nvs_set_blob(_nvs, NVS_KEY_SNAPSHOT, _snapshotBuffer, length);
+    return err == ESP_OK ? nvs_commit(_nvs) : err;
+}
+
+// =============================================================================
+// BLE Service
+// =============================================================================
+
+void JobScheduler::setupService(NimBLEServer* pServer) {
+    NimBLEService* pService = pServer->createService(SERVICE_UUID_JOBS);
+
+    // Command characteristic - Write only
+    _pCommandChar = pService->createCharacteristic(
+        CHAR_UUID_JOB_COMMAND,
+        NIMBLE_PROPERTY::WRITE
+    );
+    _pCommandChar->setCallbacks(this);
+
+    // Events characteristic - Read (summary) / Notify (job events)
+    _pEventsChar = pService->createCharacteristic(
+        CHAR_UUID_JOB_EVENTS,
+        NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY
+    );
+    _pEventsChar->setCallbacks(this);
+
+    pService->start();
+}
+
+void JobScheduler::notifyEvent(uint8_t event, uint32_t jobId, uint32_t fileId, uint32_t printerKey) {
+    if (!_pEventsChar) {
+        return;
+    }
+
+    uint8_t value[13];
+    value[0] = event;
+    uint32_t fields[3] = { jobId, fileId, printerKey };
+    memcpy(value + 1, fields, sizeof(fields));  // ESP32 is little-endian
+    _pEventsChar->setValue(value, sizeof(value));
+    _pEventsChar->notify();
+}
+
+void JobScheduler::onWrite(NimBLECharacteristic* pCharacteristic) {
+    if (pCharacteristic != _pCommandChar || !_commandQueue) {
+        return;
+    }
+
+    std::string value = pCharacteristic->getValue();
+    if (value.empty() || value.length() > sizeof(Command::data)) {
+        Serial.println("[Jobs] Invalid command length");
+        return;
+    }
+
+    Command cmd;
+    cmd.length = value.length();
+    memcpy(cmd.data, value.data(), value.length());
+    if (xQueueSend(_commandQueue, &cmd, 0) != pdTRUE) {
+        Serial.println("[Jobs] Command queue full, dropping command");
+        return;
+    }
+
+    PowerManager::wake();
+}
+
+void JobScheduler::onRead(NimBLECharacteristic* pCharacteristic) {
+    if (pCharacteristic != _pEventsChar) {
+        return;
+    }
+
+    // [u16 queued][u16 running][u8 printers][u8 idle][u32 last dispatch us][u32 max dispatch us]
+    uint8_t summary[14];
+    uint16_t counts[2] = { _queue.getQueuedCount(), _queue.getRunningCount() };
+    memcpy(summary, counts, sizeof(counts));
+    summary[4] = _queue.getPrinterCount();
+    summary[5] = _queue.getIdlePrinterCount();
+    uint32_t timing[2] = { _lastDispatchUs, _maxDispatchUs };
+    memcpy(summary + 6, timing, sizeof(timing));
+    pCharacteristic->setValue(summary, sizeof(summary));
+}
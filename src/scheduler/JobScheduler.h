@@ -0,0 +1,106 @@
+#ifndef JOB_SCHEDULER_H
+#define JOB_SCHEDULER_H
+
+#include <Arduino.h>
+#include <NimBLEDevice.h>
+#include <nvs.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <functional>
+#include "JobQueue.h"
+#include "../provisioning/BLEProvisioning.h"
+
+/**
+ * JobScheduler - On-hub print job queue and dispatcher
+ *
+ * Wraps JobQueue with the hub side of things: jobs and live printer status
+ * arrive over the job GATT service, dispatch decisions are announced as
+ * notifications (and handed to an optional on-hub printer driver), and the
+ * queue is snapshotted to NVS so it survives reboots.
+ *
+ * BLE writes are buffered and applied from poll(), so the queue is only
+ * ever touched from the main loop. Without a printer driver, jobs are only
+ * dispatched while a client is subscribed to the events characteristic.
+ */
+class JobScheduler : public BLEServiceProvider,
+                     public NimBLECharacteristicCallbacks {
+public:
+    /**
+     * Sends a job to a printer; return false if the printer refused it
+     */
+    using DispatchHandler = std::function<bool(const Job& job, uint32_t printerKey)>;
+
+    JobScheduler();
+
+    /**
+     * Restore the queue snapshot from NVS
+     * Must be called before poll()
+     */
+    bool begin();
+
+    /**
+     * Must be called in main loop - applies commands, dispatches, snapshots
+     * @param networkUp Only dispatch while the hub can reach printers
+     */
+    void poll(bool networkUp);
+
+    /**
+     * Install an on-hub printer driver (optional)
+     */
+    void setDispatchHandler(DispatchHandler handler) { _dispatchHandler = handler; }
+
+    /**
+     * Stable printer key derived from its name (FNV-1a)
+     */
+    static uint32_t printerKey(const char* name, size_t length);
+
+    /**
+     * Underlying queue (for status reporting and on-hub producers)
+     */
+    JobQueue& getQueue() { return _queue; }
+
+    /**
+     * Duration of the last and slowest dispatch decision in microseconds
+     */
+    uint32_t getLastDispatchUs() const { return _lastDispatchUs; }
+    uint32_t getMaxDispatchUs() const { return _maxDispatchUs; }
+
+    // BLEServiceProvider
+    void setupService(NimBLEServer* pServer) override;
+
+    // NimBLECharacteristicCallbacks (NimBLE 1.4.x signatures)
+    void onWrite(NimBLECharacteristic* pCharacteristic) override;
+    void onRead(NimBLECharacteristic* pCharacteristic) override;
+
+private:
+    struct Command {
+        uint8_t length;
+        uint8_t data[40];
+    };
+
+    JobQueue _queue;
+    nvs_handle_t _nvs;  // Raw NVS: Preferences hides ESP_ERR_NVS_NOT_ENOUGH_SPACE
+    DispatchHandler _dispatchHandler;
+    QueueHandle_t _commandQueue;
+
+    // BLE objects
+    NimBLECharacteristic* _pCommandChar;
+    NimBLECharacteristic* _pEventsChar;
+
+    // Snapshot
+    uint8_t* _snapshotBuffer;
+    unsigned long _lastChange;
+    unsigned long _snapshotDelay;
+
+    // Dispatch timing
+    uint32_t _lastDispatchUs;
+    uint32_t _maxDispatchUs;
+
+    void applyCommand(const Command& cmd);
+    void dispatchReady();
+    bool saveSnapshot();
+    esp_err_t writeSnapshot(size_t length);
+    void notifyEvent(uint8_t event, uint32_t jobId, uint32_t fileId, uint32_t printerKey);
+};
+
+#endif // JOB_SCHEDULER_H
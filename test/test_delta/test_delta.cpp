@@ -0,0 +1,285 @@
+/**
+ * DeltaPatcher host tests - builds patches with tools/make_ota_delta.py and
+ * decodes them against a buffer-backed base image.
+ *
+ * Needs python3 on PATH (or $PYTHON). Run with: pio test -e native -f test_delta
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+#include "ota/DeltaPatcher.h"
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+namespace fs = std::filesystem;
+
+// Assumed GATT write-without-response throughput for the transfer estimate
+const double BLE_LINK_KBPS = 20.0;
+
+// The base is an app partition: the image followed by erased flash
+const uint32_t PARTITION_SIZE = 1024 * 1024;
+
+class BufferImage : public DeltaPatcher::BaseImage {
+public:
+    BufferImage(const Bytes& image, const Bytes& hash) : _image(image), _hash(hash) {}
+
+    uint32_t size() const override { return PARTITION_SIZE; }
+
+    bool read(uint32_t offset, uint8_t* out, size_t length) override {
+        if (offset + length > PARTITION_SIZE) {
+            return false;
+        }
+        for (size_t i = 0; i < length; i++) {
+            out[i] = offset + i < _image.size() ? _image[offset + i] : 0xFF;
+        }
+        return true;
+    }
+
+    bool sha256(uint8_t* out) override {
+        memcpy(out, _hash.data(), 32);
+        return true;
+    }
+
+private:
+    const Bytes& _image;
+    Bytes _hash;
+};
+
+std::string python() {
+    const char* configured = getenv("PYTHON");
+    return configured ? configured : "python3";
+}
+
+fs::path projectDir() {
+    // __FILE__ is test/test_delta/test_delta.cpp, relative or absolute
+    return fs::path(__FILE__).parent_path().parent_path().parent_path();
+}
+
+fs::path scratch(const char* name) {
+    return fs::temp_directory_path() / (std::string("apf_delta_") + name);
+}
+
+void writeFile(const fs::path& path, const Bytes& data) {
+    FILE* f = fopen(path.string().c_str(), "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+}
+
+Bytes readFile(const fs::path& path) {
+    Bytes data;
+    FILE* f = fopen(path.string().c_str(), "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    fclose(f);
+    return data;
+}
+
+std::string run(const std::string& command) {
+    std::string output;
+    FILE* pipe = popen(command.c_str(), "r");
+    TEST_ASSERT_NOT_NULL(pipe);
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), pipe)) {
+        output += buffer;
+    }
+    TEST_ASSERT_EQUAL_INT(0, pclose(pipe));
+    return output;
+}
+
+Bytes makePatch(const Bytes& base, const Bytes& target) {
+    fs::path basePath = scratch("base.bin");
+    fs::path targetPath = scratch("target.bin");
+    fs::path patchPath = scratch("patch.bin");
+    writeFile(basePath, base);
+    writeFile(targetPath, target);
+
+    fs::path tool = projectDir() / "tools" / "make_ota_delta.py";
+    run(python() + " \"" + tool.string() + "\" \"" + basePath.string() + "\" \"" +
+        targetPath.string() + "\" \"" + patchPath.string() + "\"");
+    return readFile(patchPath);
+}
+
+// SHA-256 of the base as the hub would report it, from Python's hashlib
+Bytes hashOf(const Bytes& image) {
+    fs::path path = scratch("hashed.bin");
+    writeFile(path, image);
+    std::string hex = run(python() + " -c \"import hashlib,sys; "
+                          "print(hashlib.sha256(open(sys.argv[1],'rb').read()).hexdigest())\" \"" +
+                          path.string() + "\"");
+    TEST_ASSERT_TRUE(hex.size() >= 64);
+
+    Bytes hash(32);
+    for (size_t i = 0; i < 32; i++) {
+        hash[i] = static_cast<uint8_t>(strtoul(hex.substr(i * 2, 2).c_str(), nullptr, 16));
+    }
+    return hash;
+}
+
+Bytes randomBytes(std::mt19937& rng, size_t length) {
+    Bytes data(length);
+    for (auto& b : data) {
+        b = static_cast<uint8_t>(rng() % 256);
+    }
+    return data;
+}
+
+/**
+ * Decode a patch fed in pieces of at most split bytes
+ */
+bool decode(BufferImage& base, const Bytes& patch, size_t split, Bytes& out, DeltaPatcher& patcher) {
+    out.clear();
+    patcher.begin(&base, [&out](const uint8_t* data, size_t length) {
+        out.insert(out.end(), data, data + length);
+        return true;
+    });
+
+    for (size_t offset = 0; offset < patch.size(); offset += split) {
+        size_t n = patch.size() - offset < split ? patch.size() - offset : split;
+        if (!patcher.feed(patch.data() + offset, n)) {
+            return false;
+        }
+    }
+    return patcher.isComplete();
+}
+
+}  // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// Round Trip
+// =============================================================================
+
+/**
+ * A rebuilt firmware: code inserted near the start shifts everything after
+ * it off the block grid, scattered relocations, a removed function and new
+ * code at the end.
+ */
+void test_round_trip_of_rebuilt_image(void) {
+    std::mt19937 rng(2024);
+    Bytes base = randomBytes(rng, 192 * 1024);
+
+    Bytes target(base.begin(), base.begin() + 4096);
+    Bytes inserted = randomBytes(rng, 700);
+    target.insert(target.end(), inserted.begin(), inserted.end());
+    target.insert(target.end(), base.begin() + 4096, base.begin() + 96 * 1024);
+    target.insert(target.end(), base.begin() + 97 * 1024, base.end());
+    for (size_t offset = 8000; offset + 4 < target.size(); offset += 8191) {
+        target[offset] ^= 0x5A;
+        target[offset + 3] ^= 0xA5;
+    }
+    Bytes tail = randomBytes(rng, 6 * 1024);
+    target.insert(target.end(), tail.begin(), tail.end());
+
+    Bytes patch = makePatch(base, target);
+    BufferImage image(base, hashOf(base));
+    DeltaPatcher patcher;
+    Bytes out;
+
+    // Byte-by-byte, a BLE write and a pipeline chunk
+    const size_t SPLITS[] = { 1, 244, 4096 };
+    for (size_t split : SPLITS) {
+        TEST_ASSERT_TRUE_MESSAGE(decode(image, patch, split, out, patcher), patcher.getError());
+        TEST_ASSERT_EQUAL(target.size(), out.size());
+        TEST_ASSERT_EQUAL_MEMORY(target.data(), out.data(), target.size());
+    }
+
+    const int RUNS = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < RUNS; i++) {
+        decode(image, patch, 4096, out, patcher);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / RUNS;
+
+    double ratio = static_cast<double>(target.size()) / patch.size();
+    TEST_ASSERT_TRUE(ratio > 5.0);
+
+    char message[200];
+    snprintf(message, sizeof(message),
+             "%zu -> %zu bytes, ratio %.1fx | decode %.1f MiB/s | transfer at %.0f KiB/s: full %.1f s, delta %.1f s",
+             target.size(), patch.size(), ratio, target.size() / seconds / (1024 * 1024), BLE_LINK_KBPS,
+             target.size() / 1024.0 / BLE_LINK_KBPS, patch.size() / 1024.0 / BLE_LINK_KBPS);
+    TEST_MESSAGE(message);
+}
+
+/**
+ * Literal bytes right before an off-grid match are claimed back by the
+ * backward extension; none may be lost or duplicated.
+ */
+void test_literals_before_unaligned_match(void) {
+    std::mt19937 rng(7);
+    Bytes base = randomBytes(rng, 4096);
+
+    Bytes target = randomBytes(rng, 5);
+    target.insert(target.end(), base.begin() + 7, base.begin() + 7 + 200);
+    target.push_back(0x42);
+
+    Bytes patch = makePatch(base, target);
+    BufferImage image(base, hashOf(base));
+    DeltaPatcher patcher;
+    Bytes out;
+
+    TEST_ASSERT_TRUE_MESSAGE(decode(image, patch, 4096, out, patcher), patcher.getError());
+    TEST_ASSERT_EQUAL(target.size(), out.size());
+    TEST_ASSERT_EQUAL_MEMORY(target.data(), out.data(), target.size());
+}
+
+// =============================================================================
+// Rejection
+// =============================================================================
+
+void test_rejects_patch_for_other_base(void) {
+    std::mt19937 rng(99);
+    Bytes base = randomBytes(rng, 8192);
+    Bytes target(base.rbegin(), base.rend());
+    Bytes patch = makePatch(base, target);
+
+    Bytes other = base;
+    other[100] ^= 0xFF;
+    BufferImage image(other, hashOf(other));
+    DeltaPatcher patcher;
+    Bytes out;
+
+    TEST_ASSERT_FALSE(decode(image, patch, 4096, out, patcher));
+    TEST_ASSERT_EQUAL(0, out.size());
+    TEST_ASSERT_NOT_NULL(strstr(patcher.getError(), "different base"));
+}
+
+void test_rejects_truncated_patch(void) {
+    std::mt19937 rng(5);
+    Bytes base = randomBytes(rng, 8192);
+    Bytes target = base;
+    target[4000] ^= 0x01;
+    Bytes patch = makePatch(base, target);
+    patch.resize(patch.size() - 10);
+
+    BufferImage image(base, hashOf(base));
+    DeltaPatcher patcher;
+    Bytes out;
+
+    TEST_ASSERT_FALSE(decode(image, patch, 4096, out, patcher));
+    TEST_ASSERT_LESS_THAN(target.size(), out.size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_of_rebuilt_image);
+    RUN_TEST(test_literals_before_unaligned_match);
+    RUN_TEST(test_rejects_patch_for_other_base);
+    RUN_TEST(test_rejects_truncated_patch);
+    return UNITY_END();
+}
@@ -0,0 +1,508 @@
+/**
+ * Discovery host tests - a stand-in for a farm of 50 mDNS responders on a
+ * simulated multicast link, queried by the hub's DiscoveryScheduler.
+ * Reports resolve latency and packets per minute.
+ *
+ * Run with: pio test -e native -f test_discovery
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "config.h"
+#include "discovery/DiscoveryScheduler.h"
+#include "discovery/MdnsPacket.h"
+#include "discovery/ServiceCache.h"
+
+namespace {
+
+typedef std::vector<uint8_t> Packet;
+
+const uint8_t PRINTERS = 50;
+const uint32_t TICK_MS = 10;
+const uint32_t PTR_TTL_S = 4500;     // RFC 6762 section 10: 75 min for shared records
+const uint32_t HOST_TTL_S = 120;     // 2 min for records containing a host name
+
+const char* const SERVICE_TYPES[] = DISCOVERY_SERVICE_TYPES;
+
+MdnsName dotted(const char* text) {
+    MdnsName name;
+    name.fromDotted(text);
+    return name;
+}
+
+/**
+ * Uncompressed response writer for the stand-in printers
+ */
+class ResponseBuilder {
+public:
+    ResponseBuilder() : _packet(12, 0), _answers(0) {
+        _packet[2] = 0x84;   // Response, authoritative
+    }
+
+    void add(const MdnsName& name, uint16_t type, bool unique, uint32_t ttl, const Packet& rdata) {
+        _packet.insert(_packet.end(), name.data, name.data + name.length);
+        put16(type);
+        put16(unique ? 0x8001 : 0x0001);
+        put16(ttl >> 16);
+        put16(ttl & 0xFFFF);
+        put16(static_cast<uint16_t>(rdata.size()));
+        _packet.insert(_packet.end(), rdata.begin(), rdata.end());
+        _answers++;
+    }
+
+    bool isEmpty() const { return _answers == 0; }
+
+    Packet finish() {
+        _packet[6] = _answers >> 8;
+        _packet[7] = _answers & 0xFF;
+        return _packet;
+    }
+
+private:
+    Packet _packet;
+    uint16_t _answers;
+
+    void put16(uint16_t value) {
+        _packet.push_back(value >> 8);
+        _packet.push_back(value & 0xFF);
+    }
+};
+
+struct Delivery {
+    uint32_t at;
+    Packet packet;
+};
+
+/**
+ * A printer's mDNS responder (RFC 6762/6763 behaviour relevant to a browser)
+ */
+struct Responder {
+    uint8_t index;
+    MdnsName type;
+    MdnsName instance;
+    MdnsName host;
+    uint32_t address;
+    uint16_t port;
+    bool online;
+
+    Packet ptrData() const { return Packet(instance.data, instance.data + instance.length); }
+
+    Packet srvData() const {
+        Packet data = { 0, 0, 0, 0, static_cast<uint8_t>(port >> 8), static_cast<uint8_t>(port & 0xFF) };
+        data.insert(data.end(), host.data, host.data + host.length);
+        return data;
+    }
+
+    Packet txtData() const { return Packet{ 9, 'v', 'e', 'r', 's', 'i', 'o', 'n', '=', '1' }; }
+
+    Packet aData() const {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&address);
+        return Packet(bytes, bytes + 4);
+    }
+
+    Packet records(uint32_t ptrTtl, uint32_t hostTtl) const {
+        ResponseBuilder response;
+        response.add(type, MDNS_TYPE_PTR, false, ptrTtl, ptrData());
+        response.add(instance, MDNS_TYPE_SRV, true, hostTtl, srvData());
+        response.add(instance, MDNS_TYPE_TXT, true, ptrTtl, txtData());
+        response.add(host, MDNS_TYPE_A, true, hostTtl, aData());
+        return response.finish();
+    }
+
+    /**
+     * Answer one query burst (a query plus its TC continuations).
+     * Shared answers are delayed 20-120 ms, unique ones sent at once.
+     */
+    void onQuery(const std::vector<Packet>& burst, uint32_t now, std::mt19937& rng,
+                 std::vector<Delivery>& network) const {
+        if (!online) {
+            return;
+        }
+
+        bool wantPtr = false, wantSrv = false, wantTxt = false, wantA = false;
+        bool suppressed = false;
+        for (const auto& packet : burst) {
+            MdnsReader reader(packet.data(), packet.size());
+            if (!reader.isQuery()) {
+                continue;
+            }
+            MdnsName name;
+            uint16_t qtype;
+            while (reader.nextQuestion(name, qtype)) {
+                wantPtr = wantPtr || (qtype == MDNS_TYPE_PTR && name.equals(type));
+                wantSrv = wantSrv || (qtype == MDNS_TYPE_SRV && name.equals(instance));
+                wantTxt = wantTxt || (qtype == MDNS_TYPE_TXT && name.equals(instance));
+                wantA = wantA || (qtype == MDNS_TYPE_A && name.equals(host));
+            }
+            MdnsRecord known;
+            while (reader.next(known)) {
+                suppressed = suppressed || (known.type == MDNS_TYPE_PTR && known.name.equals(type) &&
+                                            known.target.equals(instance) && known.ttl >= PTR_TTL_S / 2);
+            }
+        }
+
+        if (wantPtr && !suppressed) {
+            network.push_back({ now + 20 + static_cast<uint32_t>(rng() % 101), records(PTR_TTL_S, HOST_TTL_S) });
+            return;
+        }
+
+        ResponseBuilder response;
+        if (wantSrv) {
+            response.add(instance, MDNS_TYPE_SRV, true, HOST_TTL_S, srvData());
+        }
+        if (wantTxt) {
+            response.add(instance, MDNS_TYPE_TXT, true, PTR_TTL_S, txtData());
+        }
+        if (wantSrv || wantA) {
+            response.add(host, MDNS_TYPE_A, true, HOST_TTL_S, aData());
+        }
+        if (!response.isEmpty()) {
+            network.push_back({ now + static_cast<uint32_t>(rng() % 10), response.finish() });
+        }
+    }
+};
+
+/**
+ * The hub side: PrinterDiscovery::poll() without the socket
+ */
+class HubStandIn {
+public:
+    HubStandIn()
+        : cache(DISCOVERY_MAX_PRINTERS)
+        , scheduler(cache, _buffer, sizeof(_buffer))
+        , rx(0)
+        , tx(0)
+        , added(0)
+        , removed(0)
+        , maxLatencyMs(0)
+        , totalLatencyMs(0)
+        , _now(0) {
+        MdnsName types[2] = { dotted(SERVICE_TYPES[0]), dotted(SERVICE_TYPES[1]) };
+        cache.setServiceTypes(types, 2);
+        cache.setEventCallback([this](DiscoveryEvent event, const DiscoveredPrinter& printer) {
+            if (event == DiscoveryEvent::REMOVED) {
+                removed++;
+                return;
+            }
+            if (event != DiscoveryEvent::ADDED) {
+                return;
+            }
+            uint32_t latency = scheduler.latencyMs(printer.firstSeenMs, _now);
+            added++;
+            totalLatencyMs += latency;
+            maxLatencyMs = latency > maxLatencyMs ? latency : maxLatencyMs;
+        });
+    }
+
+    void start(uint32_t now) {
+        scheduler.start(now);
+    }
+
+    void receive(const Packet& packet, uint32_t now) {
+        _now = now;
+        rx++;
+        MdnsReader reader(packet.data(), packet.size());
+        if (!reader.isResponse()) {
+            return;
+        }
+        MdnsRecord record;
+        while (reader.next(record)) {
+            cache.handleRecord(record, now);
+        }
+    }
+
+    /**
+     * @return the query burst sent this tick (a query plus its TC continuations)
+     */
+    std::vector<Packet> poll(uint32_t now) {
+        _now = now;
+        cache.expire(now);
+
+        std::vector<Packet> burst;
+        scheduler.poll(now, [this, &burst](size_t length) {
+            burst.push_back(Packet(_buffer, _buffer + length));
+        });
+        tx += burst.size();
+        return burst;
+    }
+
+    ServiceCache cache;
+    DiscoveryScheduler scheduler;
+    uint32_t rx;
+    uint32_t tx;
+    uint32_t added;
+    uint32_t removed;
+    uint32_t maxLatencyMs;
+    uint32_t totalLatencyMs;
+
+private:
+    uint32_t _now;
+    uint8_t _buffer[DISCOVERY_PACKET_SIZE];
+};
+
+/**
+ * Everything on the link: responders and the packets in flight to the hub
+ */
+struct Farm {
+    std::vector<Responder> printers;
+    std::vector<Delivery> network;
+    HubStandIn hub;
+    std::mt19937 rng;   // Raw engine output: std distributions differ between standard libraries
+
+    Farm() : rng(4242) {
+        for (uint8_t i = 0; i < PRINTERS; i++) {
+            char name[96];
+            Responder printer;
+            printer.index = i;
+            printer.type = dotted(SERVICE_TYPES[i % 2]);
+            snprintf(name, sizeof(name), "Printer %02u.%s", i, SERVICE_TYPES[i % 2]);
+            printer.instance = dotted(name);
+            snprintf(name, sizeof(name), "printer-%02u.local", i);
+            printer.host = dotted(name);
+            uint8_t ip[4] = { 10, 0, 0, static_cast<uint8_t>(10 + i) };
+            memcpy(&printer.address, ip, 4);
+            printer.port = i % 2 ? 7125 : 80;
+            printer.online = true;
+            printers.push_back(printer);
+        }
+    }
+
+    void announce(const Responder& printer, uint32_t at, uint32_t ptrTtl, uint32_t hostTtl) {
+        network.push_back({ at, printer.records(ptrTtl, hostTtl) });
+    }
+
+    /**
+     * Run the link from startMs to endMs
+     */
+    void run(uint32_t startMs, uint32_t endMs) {
+        for (uint32_t now = startMs; now < endMs; now += TICK_MS) {
+            for (size_t i = 0; i < network.size();) {
+                if (network[i].at > now) {
+                    i++;
+                    continue;
+                }
+                hub.receive(network[i].packet, now);
+                network.erase(network.begin() + i);
+            }
+
+            std::vector<Packet> burst = hub.poll(now);
+            if (burst.empty()) {
+                continue;
+            }
+            for (const auto& printer : printers) {
+                printer.onQuery(burst, now, rng, network);
+            }
+        }
+    }
+};
+
+}  // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// Packet Round Trips
+// =============================================================================
+
+void test_hostname_question_and_answer_round_trip(void) {
+    MdnsName hub = dotted("apf-hub-a1b2c3.local");
+    uint8_t buffer[DISCOVERY_PACKET_SIZE];
+
+    // A resolver asking for the hub
+    MdnsQuery query(buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(query.addQuestion(hub, MDNS_TYPE_A));
+    size_t length = query.finish();
+
+    MdnsReader questionReader(buffer, length);
+    TEST_ASSERT_TRUE(questionReader.isQuery());
+    MdnsName name;
+    uint16_t type = 0;
+    TEST_ASSERT_TRUE(questionReader.nextQuestion(name, type));
+    TEST_ASSERT_TRUE(name.equals(hub));
+    TEST_ASSERT_EQUAL_UINT16(MDNS_TYPE_A, type);
+    TEST_ASSERT_FALSE(questionReader.nextQuestion(name, type));
+
+    // The hub's answer
+    uint8_t ip[4] = { 192, 168, 1, 77 };
+    uint32_t address;
+    memcpy(&address, ip, 4);
+    MdnsQuery response(buffer, sizeof(buffer));
+    response.setResponse();
+    TEST_ASSERT_FALSE(response.addQuestion(hub, MDNS_TYPE_A));
+    TEST_ASSERT_TRUE(response.addAddress(hub, address, HOST_TTL_S));
+    length = response.finish();
+
+    MdnsReader answerReader(buffer, length);
+    TEST_ASSERT_TRUE(answerReader.isResponse());
+    MdnsRecord record;
+    TEST_ASSERT_TRUE(answerReader.next(record));
+    TEST_ASSERT_TRUE(record.name.equals(hub));
+    TEST_ASSERT_EQUAL_UINT16(MDNS_TYPE_A, record.type);
+    TEST_ASSERT_EQUAL_UINT32(HOST_TTL_S, record.ttl);
+    TEST_ASSERT_EQUAL_UINT32(address, record.address);
+    TEST_ASSERT_FALSE(answerReader.next(record));
+}
+
+void test_known_answers_readable_from_query(void) {
+    MdnsName type = dotted(SERVICE_TYPES[0]);
+    MdnsName instance = dotted("Voron._octoprint._tcp.local");
+    uint8_t buffer[DISCOVERY_PACKET_SIZE];
+
+    MdnsQuery query(buffer, sizeof(buffer));
+    query.addQuestion(type, MDNS_TYPE_PTR);
+    query.addKnownAnswer(type, instance, 3000);
+    size_t length = query.finish();
+
+    // next() skips unread questions
+    MdnsReader reader(buffer, length);
+    MdnsRecord record;
+    TEST_ASSERT_TRUE(reader.next(record));
+    TEST_ASSERT_EQUAL_UINT16(MDNS_TYPE_PTR, record.type);
+    TEST_ASSERT_TRUE(record.target.equals(instance));
+    TEST_ASSERT_EQUAL_UINT32(3000, record.ttl);
+}
+
+// =============================================================================
+// Query Schedule
+// =============================================================================
+
+void test_startup_burst_then_refresh_only(void) {
+    HubStandIn hub;
+    hub.start(5000);
+
+    std::vector<uint32_t> browses;
+    for (uint32_t now = 5000; now < 15000; now += TICK_MS) {
+        if (!hub.poll(now).empty()) {
+            browses.push_back(now);
+        }
+    }
+
+    // 0, 1, 3 s after start; an empty cache has nothing to refresh
+    TEST_ASSERT_EQUAL(DISCOVERY_STARTUP_QUERIES, browses.size());
+    TEST_ASSERT_EQUAL_UINT32(5000, browses[0]);
+    TEST_ASSERT_EQUAL_UINT32(6000, browses[1]);
+    TEST_ASSERT_EQUAL_UINT32(8000, browses[2]);
+    TEST_ASSERT_EQUAL_UINT32(8000, hub.scheduler.getLastQueryMs());
+}
+
+/**
+ * A full cache lists more known answers than one packet holds: they follow
+ * in continuation packets, each but the last with the TC bit set.
+ */
+void test_known_answers_overflow_into_truncated_packets(void) {
+    HubStandIn hub;
+    MdnsName type = dotted(SERVICE_TYPES[0]);
+    for (uint8_t i = 0; i < DISCOVERY_MAX_PRINTERS; i++) {
+        char name[96];
+        snprintf(name, sizeof(name), "Workshop printer with a long name %02u.%s", i, SERVICE_TYPES[0]);
+        MdnsName instance = dotted(name);
+        ResponseBuilder response;
+        response.add(type, MDNS_TYPE_PTR, false, PTR_TTL_S, Packet(instance.data, instance.data + instance.length));
+        hub.receive(response.finish(), 1000);
+    }
+
+    hub.start(2000);
+    std::vector<Packet> burst = hub.poll(2000);
+    TEST_ASSERT_GREATER_THAN(1, burst.size());
+
+    size_t known = 0;
+    for (size_t i = 0; i < burst.size(); i++) {
+        MdnsReader reader(burst[i].data(), burst[i].size());
+        TEST_ASSERT_TRUE(reader.isQuery());
+        TEST_ASSERT_EQUAL(i + 1 < burst.size(), (burst[i][2] & 0x02) != 0);
+        MdnsRecord record;
+        while (reader.next(record)) {
+            known++;
+        }
+    }
+    TEST_ASSERT_EQUAL(DISCOVERY_MAX_PRINTERS, known);
+}
+
+// =============================================================================
+// Farm Stand-In
+// =============================================================================
+
+/**
+ * 30 minutes on a link with 50 printers: 49 online at boot, one joining
+ * at 10 min (two announcements), one leaving with a goodbye at 20 min.
+ */
+void test_farm_of_50_responders(void) {
+    Farm farm;
+    HubStandIn& hub = farm.hub;
+    const uint32_t MINUTE = 60000;
+    const uint32_t T0 = 3000;    // Hub uptime when WiFi comes up
+
+    Responder& late = farm.printers[PRINTERS - 1];
+    Responder& leaving = farm.printers[0];
+    late.online = false;
+
+    // Startup: the browse burst resolves every online printer
+    hub.start(T0);
+    farm.run(T0, T0 + 5000);
+    uint32_t startupRx = hub.rx;
+    uint32_t startupTx = hub.tx;
+    uint32_t startupMaxLatency = hub.maxLatencyMs;
+    uint32_t startupAvgLatency = hub.totalLatencyMs / hub.added;
+    TEST_ASSERT_EQUAL_UINT8(PRINTERS - 1, hub.cache.getResolvedCount());
+    TEST_ASSERT_EQUAL_UINT32(PRINTERS - 1, hub.added);
+    TEST_ASSERT_GREATER_OR_EQUAL(20, startupMaxLatency);
+    TEST_ASSERT_LESS_OR_EQUAL(130, startupMaxLatency);          // 20-120 ms response delay
+    TEST_ASSERT_EQUAL_UINT32(PRINTERS - 1, startupRx);          // Known answers suppress repeats
+    TEST_ASSERT_EQUAL_UINT32(DISCOVERY_STARTUP_QUERIES, startupTx);
+
+    // Late joiner announces itself twice, one second apart
+    farm.run(T0 + 5000, T0 + 10 * MINUTE);
+    late.online = true;
+    farm.announce(late, T0 + 10 * MINUTE, PTR_TTL_S, HOST_TTL_S);
+    farm.announce(late, T0 + 10 * MINUTE + 1000, PTR_TTL_S, HOST_TTL_S);
+    uint32_t addedBefore = hub.added;
+    uint32_t latencyBefore = hub.totalLatencyMs;
+    farm.run(T0 + 10 * MINUTE, T0 + 20 * MINUTE);
+    uint32_t lateLatency = hub.totalLatencyMs - latencyBefore;
+    TEST_ASSERT_EQUAL_UINT32(addedBefore + 1, hub.added);
+    TEST_ASSERT_LESS_OR_EQUAL(TICK_MS, lateLatency);            // Resolved from the announcement alone
+    TEST_ASSERT_EQUAL_UINT8(PRINTERS, hub.cache.getResolvedCount());
+
+    // Goodbye removes the printer within a second
+    leaving.online = false;
+    farm.announce(leaving, T0 + 20 * MINUTE, 0, 0);
+    farm.run(T0 + 20 * MINUTE, T0 + 20 * MINUTE + 2000);
+    TEST_ASSERT_EQUAL_UINT32(1, hub.removed);
+    TEST_ASSERT_EQUAL_UINT8(PRINTERS - 1, hub.cache.getResolvedCount());
+
+    // Steady state: traffic is driven only by host record refreshes at 80% TTL
+    uint32_t rxBefore = hub.rx;
+    uint32_t txBefore = hub.tx;
+    farm.run(T0 + 20 * MINUTE + 2000, T0 + 30 * MINUTE + 2000);
+    double rxPerMinute = (hub.rx - rxBefore) / 10.0;
+    double txPerMinute = (hub.tx - txBefore) / 10.0;
+
+    // One answer per printer per cycle; one query burst per cycle for each
+    // group heard together (boot and late joiner), 96 questions fill two packets
+    double cyclesPerMinute = 60.0 / (HOST_TTL_S * 0.8);
+    TEST_ASSERT_TRUE(rxPerMinute <= (PRINTERS - 1) * cyclesPerMinute * 1.1);
+    TEST_ASSERT_TRUE(txPerMinute <= cyclesPerMinute * 2 * 2 * 1.1);
+    TEST_ASSERT_EQUAL_UINT32(1, hub.removed);                   // No printer expired spuriously
+    TEST_ASSERT_EQUAL_UINT8(PRINTERS - 1, hub.cache.getResolvedCount());
+
+    char message[200];
+    snprintf(message, sizeof(message),
+             "startup: %u printers in max %u ms (avg %u), %u rx / %u tx | late joiner: %u ms | steady: %.1f rx/min, %.1f tx/min",
+             PRINTERS - 1, startupMaxLatency, startupAvgLatency, startupRx, startupTx,
+             lateLatency, rxPerMinute, txPerMinute);
+    TEST_MESSAGE(message);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_hostname_question_and_answer_round_trip);
+    RUN_TEST(test_known_answers_readable_from_query);
+    RUN_TEST(test_startup_burst_then_refresh_only);
+    RUN_TEST(test_known_answers_overflow_into_truncated_packets);
+    RUN_TEST(test_farm_of_50_responders);
+    return UNITY_END();
+}
@@ -0,0 +1,290 @@
+/**
+ * JobQueue host tests - queue semantics, snapshot regressions and a
+ * dispatch benchmark against an emulated 50-printer farm.
+ *
+ * Run with: pio test -e native -f test_job_queue
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "config.h"
+#include "scheduler/JobQueue.h"
+
+namespace {
+
+const uint16_t PLA = 1u << static_cast<uint8_t>(Material::PLA);
+const uint16_t PETG = 1u << static_cast<uint8_t>(Material::PETG);
+const uint16_t ABS = 1u << static_cast<uint8_t>(Material::ABS);
+
+uint32_t dispatch(JobQueue& queue, uint32_t& printerKey) {
+    uint16_t slot = queue.dispatchNext(0, printerKey);
+    return slot == JobQueue::NO_JOB ? 0 : queue.getJob(slot).id;
+}
+
+}  // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// Ordering and Constraints
+// =============================================================================
+
+void test_dispatches_by_priority_then_fifo(void) {
+    JobQueue queue(8, 2, 3);
+    uint32_t low = queue.addJob(1, 1, Material::PLA, 40);
+    uint32_t highFirst = queue.addJob(2, 5, Material::PLA, 40);
+    uint32_t highSecond = queue.addJob(3, 5, Material::PLA, 40);
+    queue.updatePrinter(100, PrinterStatus::IDLE, PLA, 40);
+
+    uint32_t key = 0;
+    TEST_ASSERT_EQUAL_UINT32(highFirst, dispatch(queue, key));
+    TEST_ASSERT_EQUAL_UINT32(100, key);
+    TEST_ASSERT_TRUE(queue.reportResult(highFirst, true));
+    TEST_ASSERT_EQUAL_UINT32(highSecond, dispatch(queue, key));
+    TEST_ASSERT_TRUE(queue.reportResult(highSecond, true));
+    TEST_ASSERT_EQUAL_UINT32(low, dispatch(queue, key));
+}
+
+void test_respects_material_and_nozzle(void) {
+    JobQueue queue(8, 4, 3);
+    queue.addJob(1, 9, Material::ABS, 40);
+    queue.addJob(2, 9, Material::PLA, 60);
+    uint32_t fits = queue.addJob(3, 1, Material::PETG, 40);
+    queue.updatePrinter(100, PrinterStatus::IDLE, PLA | PETG, 40);
+
+    uint32_t key = 0;
+    TEST_ASSERT_EQUAL_UINT32(fits, dispatch(queue, key));
+    TEST_ASSERT_EQUAL_UINT32(0, dispatch(queue, key));
+    TEST_ASSERT_EQUAL_UINT16(2, queue.getQueuedCount());
+}
+
+void test_failed_job_requeues_until_max_attempts(void) {
+    JobQueue queue(4, 1, 2);
+    uint32_t id = queue.addJob(1, 0, Material::PLA, 40);
+    queue.updatePrinter(100, PrinterStatus::IDLE, PLA, 40);
+
+    uint32_t finished = 0;
+    JobState finalState = JobState::QUEUED;
+    queue.setFinishedCallback([&](const Job& job) {
+        finished = job.id;
+        finalState = job.state;
+    });
+
+    uint32_t key = 0;
+    TEST_ASSERT_EQUAL_UINT32(id, dispatch(queue, key));
+    TEST_ASSERT_TRUE(queue.reportResult(id, false));
+    TEST_ASSERT_EQUAL_UINT16(1, queue.getQueuedCount());
+
+    TEST_ASSERT_EQUAL_UINT32(id, dispatch(queue, key));
+    TEST_ASSERT_TRUE(queue.reportResult(id, false));
+    TEST_ASSERT_EQUAL_UINT16(0, queue.getQueuedCount());
+    TEST_ASSERT_EQUAL_UINT32(id, finished);
+    TEST_ASSERT_TRUE(finalState == JobState::FAILED);
+    TEST_ASSERT_EQUAL_UINT16(JobQueue::NO_JOB, queue.findJob(id));
+}
+
+// =============================================================================
+// Cancel Regressions
+// =============================================================================
+
+void test_cancel_twice_frees_slot_once(void) {
+    JobQueue queue(4, 1, 3);
+    uint32_t ids[4];
+    for (int i = 0; i < 4; i++) {
+        ids[i] = queue.addJob(i, 0, Material::PLA, 40);
+    }
+
+    TEST_ASSERT_TRUE(queue.cancelJob(ids[1]));
+    TEST_ASSERT_FALSE(queue.cancelJob(ids[1]));
+    TEST_ASSERT_EQUAL_UINT16(3, queue.getQueuedCount());
+
+    // Exactly one slot came free
+    TEST_ASSERT_NOT_EQUAL(0, queue.addJob(10, 0, Material::PLA, 40));
+    TEST_ASSERT_EQUAL_UINT32(0, queue.addJob(11, 0, Material::PLA, 40));
+}
+
+void test_cancel_then_snapshot_round_trip(void) {
+    JobQueue queue(4, 1, 3);
+    uint32_t kept = queue.addJob(1, 2, Material::PLA, 40);
+    uint32_t cancelled = queue.addJob(2, 3, Material::PLA, 40);
+    uint32_t other = queue.addJob(3, 1, Material::PETG, 60);
+    TEST_ASSERT_TRUE(queue.cancelJob(cancelled));
+
+    // Buffer sized for exactly the live jobs plus a guard region
+    std::vector<uint8_t> buffer(queue.maxSnapshotSize() + 16, 0xAA);
+    size_t length = queue.serialize(buffer.data(), queue.maxSnapshotSize());
+    TEST_ASSERT_NOT_EQUAL(0, length);
+    for (size_t i = length; i < buffer.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT8(0xAA, buffer[i]);
+    }
+
+    JobQueue restored(4, 1, 3);
+    TEST_ASSERT_TRUE(restored.deserialize(buffer.data(), length));
+    TEST_ASSERT_EQUAL_UINT16(2, restored.getQueuedCount());
+    TEST_ASSERT_EQUAL_UINT16(JobQueue::NO_JOB, restored.findJob(cancelled));
+    TEST_ASSERT_NOT_EQUAL(JobQueue::NO_JOB, restored.findJob(kept));
+    TEST_ASSERT_NOT_EQUAL(JobQueue::NO_JOB, restored.findJob(other));
+
+    // Restored snapshot is no larger than the original
+    TEST_ASSERT_EQUAL(length, restored.serialize(buffer.data(), restored.maxSnapshotSize()));
+}
+
+/**
+ * Two RUNNING records naming the same printer (a snapshot written across a
+ * missed status report): one keeps the printer, the other is requeued
+ * instead of vanishing from both the heap and the printer table.
+ */
+void test_snapshot_with_shared_printer_requeues_duplicate(void) {
+    JobQueue queue(4, 2, 3);
+    uint32_t first = queue.addJob(1, 0, Material::PLA, 40);
+    uint32_t second = queue.addJob(2, 0, Material::PLA, 40);
+    queue.updatePrinter(100, PrinterStatus::IDLE, PLA, 40);
+    queue.updatePrinter(101, PrinterStatus::IDLE, PLA, 40);
+
+    uint32_t key = 0;
+    TEST_ASSERT_NOT_EQUAL(0, dispatch(queue, key));
+    queue.updatePrinter(key, PrinterStatus::PRINTING, PLA, 40);
+    TEST_ASSERT_NOT_EQUAL(0, dispatch(queue, key));
+    queue.updatePrinter(key, PrinterStatus::PRINTING, PLA, 40);
+    TEST_ASSERT_EQUAL_UINT16(2, queue.getRunningCount());
+
+    std::vector<uint8_t> buffer(queue.maxSnapshotSize());
+    size_t length = queue.serialize(buffer.data(), buffer.size());
+    TEST_ASSERT_NOT_EQUAL(0, length);
+
+    // Point both records at printer 100 (printerKey is at offset 12 of a record)
+    const size_t HEADER = 13, RECORD = 22, KEY = 12;
+    for (size_t record = 0; record < 2; record++) {
+        uint8_t* p = buffer.data() + HEADER + RECORD * record + KEY;
+        p[0] = 100; p[1] = 0; p[2] = 0; p[3] = 0;
+    }
+
+    JobQueue restored(4, 2, 3);
+    TEST_ASSERT_TRUE(restored.deserialize(buffer.data(), length));
+    TEST_ASSERT_EQUAL_UINT16(1, restored.getRunningCount());
+    TEST_ASSERT_EQUAL_UINT16(1, restored.getQueuedCount());
+
+    // The requeued job goes out again once a printer is free
+    restored.updatePrinter(101, PrinterStatus::IDLE, PLA, 40);
+    uint32_t redispatched = dispatch(restored, key);
+    TEST_ASSERT_TRUE(redispatched == first || redispatched == second);
+    TEST_ASSERT_EQUAL_UINT32(101, key);
+    TEST_ASSERT_EQUAL_UINT16(2, restored.getRunningCount());
+}
+
+// =============================================================================
+// Farm Benchmark
+// =============================================================================
+
+/**
+ * 250 jobs on 50 printers with mixed materials and nozzles. Printers take
+ * 1-5 simulated minutes per job; every job must run on a compatible
+ * printer, and every job some printer can take must finish.
+ */
+void test_farm_250_jobs_50_printers(void) {
+    const uint16_t JOBS = 250;
+    const uint8_t PRINTERS = 50;
+    const uint8_t NOZZLES[] = { 40, 40, 40, 60, 80 };
+
+    JobQueue queue(SCHED_MAX_JOBS, SCHED_MAX_PRINTERS, SCHED_MAX_ATTEMPTS);
+    // Raw engine output: std distributions differ between standard libraries
+    std::mt19937 rng(12345);
+
+    struct FarmPrinter {
+        uint32_t key;
+        uint16_t materials;
+        uint8_t nozzle;
+        uint32_t jobId;
+        uint32_t busyUntil;
+    };
+    std::vector<FarmPrinter> printers;
+    for (uint8_t i = 0; i < PRINTERS; i++) {
+        uint16_t materials = PLA | (i % 2 ? PETG : 0) | (i % 5 == 0 ? ABS : 0);
+        FarmPrinter printer = { 1000u + i, materials, NOZZLES[i % 5], 0, 0 };
+        printers.push_back(printer);
+        queue.updatePrinter(printer.key, PrinterStatus::IDLE, printer.materials, printer.nozzle);
+    }
+
+    const Material MATERIALS[] = { Material::PLA, Material::PLA, Material::PETG, Material::ABS };
+    for (uint16_t i = 0; i < JOBS; i++) {
+        Material material = MATERIALS[rng() % 4];
+        uint8_t nozzle = NOZZLES[rng() % 5];
+        TEST_ASSERT_NOT_EQUAL(0, queue.addJob(i, rng() % 4, material, nozzle));
+    }
+
+    uint32_t done = 0;
+    queue.setFinishedCallback([&done](const Job& job) {
+        if (job.state == JobState::DONE) {
+            done++;
+        }
+    });
+
+    uint32_t dispatches = 0;
+    double totalUs = 0;
+    double maxUs = 0;
+    uint32_t minute = 0;
+
+    while (minute < 10000) {
+        for (auto& printer : printers) {
+            if (printer.jobId != 0 && printer.busyUntil <= minute) {
+                queue.updatePrinter(printer.key, PrinterStatus::IDLE, printer.materials, printer.nozzle);
+                printer.jobId = 0;
+            }
+        }
+
+        for (;;) {
+            uint32_t key = 0;
+            auto start = std::chrono::steady_clock::now();
+            uint16_t slot = queue.dispatchNext(minute * 60000, key);
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            if (slot == JobQueue::NO_JOB) {
+                break;
+            }
+            dispatches++;
+            totalUs += us;
+            maxUs = us > maxUs ? us : maxUs;
+
+            const Job& job = queue.getJob(slot);
+            FarmPrinter& printer = printers[key - 1000u];
+            TEST_ASSERT_TRUE(printer.materials & (1u << static_cast<uint8_t>(job.material)));
+            TEST_ASSERT_EQUAL_UINT8(printer.nozzle, job.nozzle);
+
+            printer.jobId = job.id;
+            printer.busyUntil = minute + 1 + rng() % 5;
+            queue.updatePrinter(printer.key, PrinterStatus::PRINTING, printer.materials, printer.nozzle);
+        }
+        minute++;
+
+        // Whatever is still queued now has no compatible printer
+        if (queue.getRunningCount() == 0) {
+            break;
+        }
+    }
+
+    // Only ABS printers with a 0.4 mm nozzle exist, other ABS jobs stay queued
+    uint32_t stranded = queue.getQueuedCount();
+    TEST_ASSERT_EQUAL_UINT32(JOBS, done + stranded);
+    TEST_ASSERT_EQUAL_UINT32(done, dispatches);
+
+    char message[160];
+    snprintf(message, sizeof(message),
+             "%u dispatches, %u stranded, %u simulated min | dispatch avg %.2f us, max %.2f us",
+             dispatches, stranded, minute, totalUs / dispatches, maxUs);
+    TEST_MESSAGE(message);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_dispatches_by_priority_then_fifo);
+    RUN_TEST(test_respects_material_and_nozzle);
+    RUN_TEST(test_failed_job_requeues_until_max_attempts);
+    RUN_TEST(test_cancel_twice_frees_slot_once);
+    RUN_TEST(test_cancel_then_snapshot_round_trip);
+    RUN_TEST(test_snapshot_with_shared_printer_requeues_duplicate);
+    RUN_TEST(test_farm_250_jobs_50_printers);
+    return UNITY_END();
+}
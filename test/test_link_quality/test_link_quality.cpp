@@ -0,0 +1,240 @@
+/**
+ * LinkQuality host tests - replays RSSI/RTT traces of a hub whose link
+ * degrades and checks when a roam triggers and which AP is chosen.
+ *
+ * Run with: pio test -e native -f test_link_quality
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <vector>
+#include "config.h"
+#include "network/LinkQuality.h"
+
+namespace {
+
+const uint8_t AP_A[6] = { 0x02, 0, 0, 0, 0, 0xA1 };
+const uint8_t AP_B[6] = { 0x02, 0, 0, 0, 0, 0xB2 };
+const uint8_t AP_C[6] = { 0x02, 0, 0, 0, 0, 0xC3 };
+
+// RSSI of an AP at time t (seconds), as seen by the moving hub
+typedef int8_t (*RssiTrace)(uint32_t t);
+
+struct TraceAp {
+    const uint8_t* bssid;
+    int32_t channel;
+    RssiTrace rssi;
+};
+
+struct RoamResult {
+    int roams;
+    uint32_t firstRoamAt;      // Seconds into the trace
+    const uint8_t* connected;  // BSSID at the end of the trace
+};
+
+// Deterministic +/-3 dB fading so traces are noisy but reproducible
+int8_t fade(uint32_t t) {
+    return static_cast<int8_t>(((t * 7919u) % 7) - 3);
+}
+
+int8_t walkAwayFromA(uint32_t t) { return static_cast<int8_t>(-50 - (35 * (int)t) / 60 + fade(t)); }
+int8_t walkTowardB(uint32_t t)   { return static_cast<int8_t>(-85 + (35 * (int)t) / 60 + fade(t + 3)); }
+int8_t distantC(uint32_t t)      { return static_cast<int8_t>(-80 + fade(t + 5)); }
+int8_t steadyWeak(uint32_t t)    { return static_cast<int8_t>(-74 + fade(t)); }
+int8_t steadyWeakOther(uint32_t t) { return static_cast<int8_t>(-71 + fade(t + 2)); }
+
+LinkQuality makeQuality() {
+    return LinkQuality(LINK_EWMA_ALPHA_PCT, LINK_POOR_RSSI_DBM, LINK_POOR_RTT_MS, LINK_ROAM_HYSTERESIS_DB);
+}
+
+/**
+ * Replay the traces the way LinkMonitor drives LinkQuality: one RSSI
+ * sample per LINK_RSSI_INTERVAL_MS, a scan when the link is poor (at most
+ * once per LINK_ROAM_COOLDOWN_MS), and a reset after each roam.
+ */
+RoamResult replay(const std::vector<TraceAp>& aps, size_t startAp, uint32_t seconds,
+                  uint32_t (*rttAt)(uint32_t t) = nullptr) {
+    LinkQuality quality = makeQuality();
+    size_t connected = startAp;
+    RoamResult result = { 0, 0, aps[startAp].bssid };
+    bool scanned = false;
+    uint32_t lastScanMs = 0;
+
+    for (uint32_t ms = 0; ms <= seconds * 1000; ms += LINK_RSSI_INTERVAL_MS) {
+        uint32_t t = ms / 1000;
+        quality.addRssi(aps[connected].rssi(t));
+        if (rttAt && ms % LINK_RTT_INTERVAL_MS == 0) {
+            quality.addRtt(rttAt(t));
+        }
+
+        if (!quality.isPoor() || (scanned && ms - lastScanMs <= LINK_ROAM_COOLDOWN_MS)) {
+            continue;
+        }
+        scanned = true;
+        lastScanMs = ms;
+
+        std::vector<ApCandidate> candidates;
+        for (const auto& ap : aps) {
+            ApCandidate candidate = {};
+            memcpy(candidate.bssid, ap.bssid, 6);
+            candidate.rssi = ap.rssi(t);
+            candidate.channel = ap.channel;
+            candidates.push_back(candidate);
+        }
+
+        int choice = quality.selectCandidate(candidates.data(), candidates.size(), aps[connected].bssid);
+        if (choice >= 0) {
+            if (result.roams == 0) {
+                result.firstRoamAt = t;
+            }
+            result.roams++;
+            connected = static_cast<size_t>(choice);
+            result.connected = aps[connected].bssid;
+            quality.reset();
+        }
+    }
+
+    return result;
+}
+
+}  // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// =============================================================================
+// Smoothing
+// =============================================================================
+
+void test_first_sample_seeds_average(void) {
+    LinkQuality quality = makeQuality();
+    quality.addRssi(-60);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, -60.0f, quality.getRssi());
+    quality.addRtt(20);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 20.0f, quality.getRttMs());
+}
+
+void test_single_dip_does_not_mark_link_poor(void) {
+    LinkQuality quality = makeQuality();
+    for (int i = 0; i < 20; i++) {
+        quality.addRssi(-60);
+    }
+    quality.addRssi(-95);
+    TEST_ASSERT_FALSE(quality.isPoor());
+}
+
+void test_sustained_drop_marks_link_poor(void) {
+    LinkQuality quality = makeQuality();
+    for (int i = 0; i < 20; i++) {
+        quality.addRssi(-60);
+    }
+    int samples = 0;
+    while (!quality.isPoor() && samples < 50) {
+        quality.addRssi(-85);
+        samples++;
+    }
+    TEST_ASSERT_TRUE(quality.isPoor());
+    TEST_ASSERT_LESS_OR_EQUAL(10, samples);
+}
+
+void test_high_rtt_marks_link_poor(void) {
+    LinkQuality quality = makeQuality();
+    quality.addRssi(-55);
+    for (int i = 0; i < 20; i++) {
+        quality.addRtt(LINK_POOR_RTT_MS * 2);
+    }
+    TEST_ASSERT_TRUE(quality.isPoor());
+}
+
+// =============================================================================
+// Candidate Selection
+// =============================================================================
+
+void test_selects_strongest_candidate_above_hysteresis(void) {
+    LinkQuality quality = makeQuality();
+    quality.addRssi(-78);
+
+    ApCandidate candidates[] = {
+        { { 0x02, 0, 0, 0, 0, 0xA1 }, -40, 1 },   // Current AP, skipped
+        { { 0x02, 0, 0, 0, 0, 0xB2 }, -62, 6 },
+        { { 0x02, 0, 0, 0, 0, 0xC3 }, -55, 11 },
+        { { 0x02, 0, 0, 0, 0, 0xD4 }, -74, 1 },   // Below hysteresis
+    };
+    TEST_ASSERT_EQUAL_INT(2, quality.selectCandidate(candidates, 4, AP_A));
+}
+
+void test_stays_when_no_candidate_clears_hysteresis(void) {
+    LinkQuality quality = makeQuality();
+    quality.addRssi(-75);
+
+    ApCandidate candidates[] = {
+        { { 0x02, 0, 0, 0, 0, 0xB2 }, static_cast<int8_t>(-75 + LINK_ROAM_HYSTERESIS_DB - 1), 6 },
+    };
+    TEST_ASSERT_EQUAL_INT(-1, quality.selectCandidate(candidates, 1, AP_A));
+}
+
+// =============================================================================
+// Trace Replay
+// =============================================================================
+
+void test_walking_between_aps_roams_once_to_nearer_ap(void) {
+    std::vector<TraceAp> aps = {
+        { AP_A, 1, walkAwayFromA },
+        { AP_B, 6, walkTowardB },
+        { AP_C, 11, distantC },
+    };
+
+    RoamResult result = replay(aps, 0, 60);
+
+    // A's smoothed RSSI crosses LINK_POOR_RSSI_DBM around t = 38 s
+    TEST_ASSERT_EQUAL_INT(1, result.roams);
+    TEST_ASSERT_GREATER_OR_EQUAL(34, result.firstRoamAt);
+    TEST_ASSERT_LESS_OR_EQUAL(48, result.firstRoamAt);
+    TEST_ASSERT_EQUAL_MEMORY(AP_B, result.connected, 6);
+}
+
+void test_equal_weak_aps_do_not_ping_pong(void) {
+    std::vector<TraceAp> aps = {
+        { AP_A, 1, steadyWeak },
+        { AP_B, 6, steadyWeakOther },
+    };
+
+    RoamResult result = replay(aps, 0, 300);
+
+    TEST_ASSERT_EQUAL_INT(0, result.roams);
+    TEST_ASSERT_EQUAL_MEMORY(AP_A, result.connected, 6);
+}
+
+uint32_t congestedRtt(uint32_t t) {
+    return t < 20 ? 15 : 400;
+}
+
+int8_t strongA(uint32_t t) { return static_cast<int8_t>(-58 + fade(t)); }
+int8_t strongerB(uint32_t t) { return static_cast<int8_t>(-45 + fade(t + 1)); }
+
+void test_congested_ap_roams_on_rtt(void) {
+    std::vector<TraceAp> aps = {
+        { AP_A, 1, strongA },
+        { AP_B, 6, strongerB },
+    };
+
+    RoamResult result = replay(aps, 0, 60, congestedRtt);
+
+    TEST_ASSERT_EQUAL_INT(1, result.roams);
+    TEST_ASSERT_GREATER_OR_EQUAL(20, result.firstRoamAt);
+    TEST_ASSERT_EQUAL_MEMORY(AP_B, result.connected, 6);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sample_seeds_average);
+    RUN_TEST(test_single_dip_does_not_mark_link_poor);
+    RUN_TEST(test_sustained_drop_marks_link_poor);
+    RUN_TEST(test_high_rtt_marks_link_poor);
+    RUN_TEST(test_selects_strongest_candidate_above_hysteresis);
+    RUN_TEST(test_stays_when_no_candidate_clears_hysteresis);
+    RUN_TEST(test_walking_between_aps_roams_once_to_nearer_ap);
+    RUN_TEST(test_equal_weak_aps_do_not_ping_pong);
+    RUN_TEST(test_congested_ap_roams_on_rtt);
+    return UNITY_END();
+}
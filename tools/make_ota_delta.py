@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""
+AutoPrintFarm Hub - OTA delta patch generator
+
+Builds a delta patch that turns the firmware currently running on a hub
+(base) into a new firmware image (target). Format matches
+src/ota/DeltaPatcher.h:
+
+    header:  "APFD" | u32 target size | u8[32] SHA-256 of the base image
+    ops:     0x01 COPY   | u32 base offset | u32 length
+             0x02 INSERT | u32 length | literal bytes
+
+The hub verifies the signature of the reconstructed image, so sign the
+target image itself, not the patch:
+
+    openssl dgst -sha256 -sign ~/.config/apf-hub/ota_key.pem -out firmware.sig firmware.bin
+
+Usage:
+    make_ota_delta.py base.bin target.bin patch.bin
+"""
+
+import hashlib
+import struct
+import sys
+
+MAGIC = b"APFD"
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+BLOCK = 32          # Match granularity for the base index, and so the shortest COPY
+HASH_LEN = 32
+
+
+def image_hash(image):
+    """Hash the way esp_partition_get_sha256() reports it for app images."""
+    # ESP-IDF appends SHA-256 of the image; the device returns that digest
+    if len(image) > HASH_LEN and hashlib.sha256(image[:-HASH_LEN]).digest() == image[-HASH_LEN:]:
+        return image[-HASH_LEN:]
+    return hashlib.sha256(image).digest()
+
+
+def build_index(base):
+    index = {}
+    for offset in range(0, len(base) - BLOCK + 1, BLOCK):
+        index.setdefault(base[offset:offset + BLOCK], offset)
+    return index
+
+
+def make_delta(base, target):
+    index = build_index(base)
+    ops = []
+    literal = bytearray()
+
+    def flush_literal():
+        if literal:
+            ops.append(struct.pack("<BI", OP_INSERT, len(literal)) + bytes(literal))
+            literal.clear()
+
+    pos = 0
+    while pos < len(target):
+        match = index.get(target[pos:pos + BLOCK])
+        if match is None:
+            literal.append(target[pos])
+            pos += 1
+            continue
+
+        # Extend backwards into pending literals, then forwards
+        start, src = pos, match
+        while literal and src > 0 and base[src - 1] == literal[-1]:
+            literal.pop()
+            start -= 1
+            src -= 1
+        end, src_end = pos + BLOCK, match + BLOCK
+        while end < len(target) and src_end < len(base) and target[end] == base[src_end]:
+            end += 1
+            src_end += 1
+
+        # A COPY (9 bytes) always beats BLOCK literal bytes, so every match is taken
+        flush_literal()
+        ops.append(struct.pack("<BII", OP_COPY, src, end - start))
+        pos = end
+
+    flush_literal()
+    header = MAGIC + struct.pack("<I", len(target)) + image_hash(base)
+    return header + b"".join(ops)
+
+
+def main():
+    if len(sys.argv) != 4:
+        print(__doc__)
+        return 1
+
+    with open(sys.argv[1], "rb") as f:
+        base = f.read()
+    with open(sys.argv[2], "rb") as f:
+        target = f.read()
+
+    patch = make_delta(base, target)
+    with open(sys.argv[3], "wb") as f:
+        f.write(patch)
+
+    print(f"Target: {len(target)} bytes, patch: {len(patch)} bytes, "
+          f"ratio {len(target) / len(patch):.2f}x")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
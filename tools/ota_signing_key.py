@@ -0,0 +1,72 @@
+"""
+AutoPrintFarm Hub - OTA signing key embedding (PlatformIO pre-build script)
+
+Reads the OTA signing public key from the PEM file named by
+custom_ota_signing_pubkey in platformio.ini and generates ota_signing_key.h
+with OTA_SIGNING_PUBKEY_PEM. The build stops if the key is missing, so no
+firmware ships with a key nobody owns.
+
+The default env (esp32-s3) builds against keys/ota_signing_dev_pub.pem, a
+development key whose private half was never kept: such a build runs, but
+accepts no OTA image. To test OTA, create your own pair outside the repo
+and point the build at it with APF_OTA_SIGNING_PUBKEY:
+
+    mkdir -p ~/.config/apf-hub
+    openssl ecparam -name prime256v1 -genkey -noout -out ~/.config/apf-hub/ota_key.pem
+    openssl ec -in ~/.config/apf-hub/ota_key.pem -pubout -out ~/.config/apf-hub/ota_pub.pem
+    APF_OTA_SIGNING_PUBKEY=~/.config/apf-hub/ota_pub.pem pio run
+
+Release builds (esp32-s3-release) use the farm key, which the release
+machine drops into keys/ota_signing_pub.pem. Private keys never go in the
+repo; .gitignore excludes keys/ apart from the development public key.
+"""
+
+import os
+
+Import("env")  # noqa: F821 - provided by PlatformIO
+
+OPTION = "custom_ota_signing_pubkey"
+ENV_OVERRIDE = "APF_OTA_SIGNING_PUBKEY"
+DEV_KEY = "keys/ota_signing_dev_pub.pem"
+
+
+def fail(message):
+    print("Error: %s" % message)
+    env.Exit(1)  # noqa: F821
+
+
+key_option = os.environ.get(ENV_OVERRIDE) or env.GetProjectOption(OPTION, "")  # noqa: F821
+if not key_option:
+    fail("%s is not set in platformio.ini" % OPTION)
+
+key_path = os.path.join(env.subst("$PROJECT_DIR"), os.path.expanduser(key_option))  # noqa: F821
+if not os.path.isfile(key_path):
+    fail("OTA signing public key not found: %s" % key_path)
+
+with open(key_path) as f:
+    pem = f.read().strip()
+
+if not pem.startswith("-----BEGIN PUBLIC KEY-----") or not pem.endswith("-----END PUBLIC KEY-----"):
+    fail("%s is not a PEM public key (expected output of 'openssl ec -pubout')" % key_path)
+
+if os.path.normpath(key_option) == os.path.normpath(DEV_KEY):
+    print("Warning: building with the development OTA key - this firmware accepts no OTA image")
+
+out_dir = os.path.join(env.subst("$BUILD_DIR"), "generated")  # noqa: F821
+os.makedirs(out_dir, exist_ok=True)
+
+lines = "".join('    "%s\\n" \\\n' % line.strip() for line in pem.splitlines())
+header = (
+    "// Generated by tools/ota_signing_key.py from %s - do not edit\n"
+    "#ifndef OTA_SIGNING_KEY_H\n"
+    "#define OTA_SIGNING_KEY_H\n\n"
+    "#define OTA_SIGNING_PUBKEY_PEM \\\n%s\n"
+    "#endif // OTA_SIGNING_KEY_H\n" % (os.path.basename(key_path), lines)
+)
+
+header_path = os.path.join(out_dir, "ota_signing_key.h")
+if not os.path.isfile(header_path) or open(header_path).read() != header:
+    with open(header_path, "w") as f:
+        f.write(header)
+
+env.Append(CPPPATH=[out_dir])  # noqa: F821
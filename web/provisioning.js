@@ -9,6 +9,17 @@ const CHAR_UUID_PASSWORD = 'beb5483f-36e1-4688-b7f5-ea07361b26a8';
 const CHAR_UUID_COMMAND = 'beb54840-36e1-4688-b7f5-ea07361b26a8';
 const CHAR_UUID_STATUS = 'beb54841-36e1-4688-b7f5-ea07361b26a8';
 
+// OTA service
+const SERVICE_UUID_OTA = '4fafc202-1fb5-459e-8fcc-c5c9c331914b';
+const CHAR_UUID_OTA_CONTROL = 'beb54842-36e1-4688-b7f5-ea07361b26a8';
+const CHAR_UUID_OTA_DATA = 'beb54843-36e1-4688-b7f5-ea07361b26a8';
+
+// Power service
+const SERVICE_UUID_POWER = '4fafc203-1fb5-459e-8fcc-c5c9c331914b';
+const CHAR_UUID_POWER_PROFILE = 'beb54844-36e1-4688-b7f5-ea07361b26a8';
+const CHAR_UUID_POWER_STATS = 'beb54845-36e1-4688-b7f5-ea07361b26a8';
+const CHAR_UUID_POWER_ECHO = 'beb54848-36e1-4688-b7f5-ea07361b26a8';
+
 // Commands
 const CMD_CONNECT = 0x01;
 const CMD_DISCONNECT = 0x02;
@@ -22,6 +33,22 @@ const STATUS_FAILED = 0x03;
 const STATUS_DISCONNECTED = 0x04;
 const STATUS_NO_CREDENTIALS = 0x05;
 
+// OTA commands and status
+const OTA_CMD_BEGIN = 0x01;
+const OTA_CMD_END = 0x02;
+const OTA_STATUS_RECEIVING = 0x01;
+const OTA_STATUS_VERIFYING = 0x02;
+const OTA_STATUS_SUCCESS = 0x03;
+const OTA_STATUS_ERROR = 0x04;
+const OTA_STATUS_BUSY = 0x05;
+
+// Status queries sent after a profile change to measure its latency
+const POWER_ECHO_SAMPLES = 5;
+const POWER_PS_NAMES = { 0: 'none', 1: 'min-modem', 2: 'max-modem', 255: 'not started' };
+
+// Bytes per OTA data write, after the 4-byte offset (fits the default ATT MTU of 247)
+const OTA_WRITE_SIZE = 240;
+
 // Global state
 let bleDevice = null;
 let bleServer = null;
@@ -29,6 +56,16 @@ let ssidCharacteristic = null;
 let passwordCharacteristic = null;
 let commandCharacteristic = null;
 let statusCharacteristic = null;
+let otaControlCharacteristic = null;
+let otaDataCharacteristic = null;
+let powerProfileCharacteristic = null;
+let powerStatsCharacteristic = null;
+let powerEchoCharacteristic = null;
+
+// OTA flow control, driven by control notifications
+let otaPaused = false;          // Hub dropped a write, wait for RECEIVING
+let otaResumeOffset = null;     // Offset to resend from once resumed
+let otaWaiters = [];            // Resolved with the status of the next notification
 
 // =============================================================================
 // Logging
@@ -96,7 +133,7 @@ async function connectToBLE() {
         // Request the device with our service UUID
         bleDevice = await navigator.bluetooth.requestDevice({
             filters: [{ services: [SERVICE_UUID] }],
-            optionalServices: [SERVICE_UUID]
+            optionalServices: [SERVICE_UUID, SERVICE_UUID_OTA, SERVICE_UUID_POWER]
         });
 
         log(`Found device: ${bleDevice.name}`, 'success');
@@ -120,6 +157,34 @@ async function connectToBLE() {
         commandCharacteristic = await service.getCharacteristic(CHAR_UUID_COMMAND);
         statusCharacteristic = await service.getCharacteristic(CHAR_UUID_STATUS);
 
+        // OTA service is optional (older firmware does not have it)
+        try {
+            const otaService = await bleServer.getPrimaryService(SERVICE_UUID_OTA);
+            otaControlCharacteristic = await otaService.getCharacteristic(CHAR_UUID_OTA_CONTROL);
+            otaDataCharacteristic = await otaService.getCharacteristic(CHAR_UUID_OTA_DATA);
+            await otaControlCharacteristic.startNotifications();
+            otaControlCharacteristic.addEventListener('characteristicvaluechanged', handleOtaNotification);
+        } catch (e) {
+            log('Firmware update not supported by this hub', 'info');
+        }
+
+        // Power service is optional as well
+        try {
+            const powerService = await bleServer.getPrimaryService(SERVICE_UUID_POWER);
+            powerProfileCharacteristic = await powerService.getCharacteristic(CHAR_UUID_POWER_PROFILE);
+            powerStatsCharacteristic = await powerService.getCharacteristic(CHAR_UUID_POWER_STATS);
+            try {
+                powerEchoCharacteristic = await powerService.getCharacteristic(CHAR_UUID_POWER_ECHO);
+                await powerEchoCharacteristic.startNotifications();
+            } catch (e) {
+                powerEchoCharacteristic = null;
+            }
+            const profileValue = await powerProfileCharacteristic.readValue();
+            document.getElementById('powerProfile').value = profileValue.getUint8(0);
+        } catch (e) {
+            log('Power profiles not supported by this hub', 'info');
+        }
+
         // Subscribe to status notifications
         await statusCharacteristic.startNotifications();
         statusCharacteristic.addEventListener('characteristicvaluechanged', handleStatusNotification);
@@ -161,6 +226,11 @@ function onDisconnected(event) {
     passwordCharacteristic = null;
     commandCharacteristic = null;
     statusCharacteristic = null;
+    otaControlCharacteristic = null;
+    otaDataCharacteristic = null;
+    powerProfileCharacteristic = null;
+    powerStatsCharacteristic = null;
+    powerEchoCharacteristic = null;
 }
 
 async function disconnectBLE() {
@@ -217,6 +287,197 @@ async function disconnectWifi() {
     }
 }
 
+// =============================================================================
+// Power Profile
+// =============================================================================
+
+async function setPowerProfile() {
+    if (!powerProfileCharacteristic) {
+        log('Power profiles not supported by this hub', 'error');
+        return;
+    }
+
+    try {
+        const profile = parseInt(document.getElementById('powerProfile').value, 10);
+        log(`Setting power profile ${profile}...`, 'info');
+        await powerProfileCharacteristic.writeValue(new Uint8Array([profile]));
+
+        // Give the hub a moment to apply, then query it so it has a latency figure
+        await new Promise(resolve => setTimeout(resolve, 500));
+        const roundTripMs = await measureQueryLatency();
+
+        const stats = await powerStatsCharacteristic.readValue();
+        const active = stats.getUint8(0);
+        let message = `Power profile ${active} active, ` +
+            `wake latency ${stats.getUint32(1, true)} us (max ${stats.getUint32(5, true)} us), ` +
+            `nominal ${stats.getUint16(9, true)} mA`;
+        if (stats.byteLength >= 24) {
+            const ps = stats.getUint8(11);
+            message += `, WiFi power save ${POWER_PS_NAMES[ps] || ps}` +
+                `, query latency ${stats.getUint32(12 + active * 4, true)} us on the hub`;
+        }
+        if (roundTripMs !== null) {
+            message += ` (${roundTripMs.toFixed(1)} ms round trip)`;
+        }
+        log(message, 'success');
+    } catch (error) {
+        log(`Error: ${error.message}`, 'error');
+        console.error(error);
+    }
+}
+
+/**
+ * Send a few echo queries; the hub times each one and the average round
+ * trip seen from the browser is returned (null if unsupported)
+ */
+async function measureQueryLatency() {
+    if (!powerEchoCharacteristic) {
+        return null;
+    }
+
+    let totalMs = 0;
+    for (let i = 0; i < POWER_ECHO_SAMPLES; i++) {
+        const replied = new Promise(resolve => {
+            powerEchoCharacteristic.addEventListener('characteristicvaluechanged', resolve, { once: true });
+        });
+        const start = performance.now();
+        await powerEchoCharacteristic.writeValue(new Uint8Array([i]));
+        await replied;
+        totalMs += performance.now() - start;
+    }
+    return totalMs / POWER_ECHO_SAMPLES;
+}
+
+// =============================================================================
+// Firmware Update
+// =============================================================================
+
+async function updateFirmware() {
+    const firmwareFile = document.getElementById('firmwareFile').files[0];
+    const signatureFile = document.getElementById('signatureFile').files[0];
+
+    if (!otaControlCharacteristic) {
+        log('Firmware update not supported by this hub', 'error');
+        return;
+    }
+    if (!firmwareFile || !signatureFile) {
+        log('Please select a firmware image and its signature', 'error');
+        return;
+    }
+
+    try {
+        const firmware = new Uint8Array(await firmwareFile.arrayBuffer());
+        const signature = new Uint8Array(await signatureFile.arrayBuffer());
+
+        // BEGIN: [cmd][u32 payload size LE]
+        const begin = new Uint8Array(5);
+        begin[0] = OTA_CMD_BEGIN;
+        new DataView(begin.buffer).setUint32(1, firmware.length, true);
+        await otaControlCharacteristic.writeValue(begin);
+
+        log(`Uploading ${firmware.length} bytes...`, 'info');
+        otaPaused = false;
+        otaResumeOffset = null;
+        const startTime = performance.now();
+        let lastLogged = 0;
+        let resumes = 0;
+        let offset = 0;
+        let ended = false;
+
+        // END: [cmd][DER signature]
+        const end = new Uint8Array(1 + signature.length);
+        end[0] = OTA_CMD_END;
+        end.set(signature, 1);
+
+        for (;;) {
+            // The hub drops writes it cannot take and says where to resume
+            if (otaPaused) {
+                await nextOtaStatus();
+                continue;
+            }
+            if (otaResumeOffset !== null) {
+                offset = otaResumeOffset;
+                otaResumeOffset = null;
+                ended = false;
+                resumes++;
+            }
+
+            if (offset < firmware.length) {
+                // Data: [u32 payload offset LE][bytes]
+                const chunk = firmware.subarray(offset, offset + OTA_WRITE_SIZE);
+                const packet = new Uint8Array(4 + chunk.length);
+                new DataView(packet.buffer).setUint32(0, offset, true);
+                packet.set(chunk, 4);
+                await otaDataCharacteristic.writeValueWithoutResponse(packet);
+                offset += chunk.length;
+
+                const percent = Math.floor(offset * 100 / firmware.length);
+                if (percent >= lastLogged + 10) {
+                    lastLogged = percent;
+                    log(`Uploaded ${percent}%`, 'info');
+                }
+                continue;
+            }
+
+            if (!ended) {
+                const seconds = (performance.now() - startTime) / 1000;
+                log(`Upload finished in ${seconds.toFixed(1)} s ` +
+                    `(${(firmware.length / 1024 / seconds).toFixed(1)} KiB/s, ${resumes} resumes)`, 'info');
+                await otaControlCharacteristic.writeValue(end);
+                ended = true;
+            }
+
+            // Verification starts, or a late BUSY sends us back to resending
+            const status = await nextOtaStatus();
+            if (status !== OTA_STATUS_BUSY && status !== OTA_STATUS_RECEIVING) {
+                break;
+            }
+        }
+        log('Verifying firmware...', 'info');
+
+    } catch (error) {
+        log(`Firmware update failed: ${error.message}`, 'error');
+        console.error(error);
+    }
+}
+
+function nextOtaStatus() {
+    return new Promise(resolve => otaWaiters.push(resolve));
+}
+
+function handleOtaNotification(event) {
+    const value = event.target.value;
+    const status = value.getUint8(0);
+    const error = value.byteLength > 1 ? value.getUint8(1) : 0;
+    const accepted = value.byteLength >= 6 ? value.getUint32(2, true) : null;
+
+    // BUSY pauses the upload; the RECEIVING that follows says where to resume
+    if (status === OTA_STATUS_BUSY) {
+        otaPaused = true;
+    } else if (status === OTA_STATUS_RECEIVING && otaPaused) {
+        otaPaused = false;
+        otaResumeOffset = accepted;
+    }
+
+    const waiters = otaWaiters;
+    otaWaiters = [];
+    waiters.forEach(resolve => resolve(status));
+
+    if (status === OTA_STATUS_BUSY) {
+        return;
+    }
+
+    if (status === OTA_STATUS_SUCCESS) {
+        log('Firmware verified, hub is rebooting', 'success');
+    } else if (status === OTA_STATUS_ERROR) {
+        log(`Firmware update failed (error 0x${error.toString(16).padStart(2, '0')})`, 'error');
+    } else if (status === OTA_STATUS_VERIFYING) {
+        log('Checking firmware signature...', 'info');
+    } else if (status === OTA_STATUS_RECEIVING) {
+        log('Hub is receiving firmware', 'info');
+    }
+}
+
 // =============================================================================
 // Status Notifications
 // =============================================================================